@@ -3,7 +3,6 @@
 #include <SFML/Audio.hpp>
 #include <cctype>
 #include <cstring>
-#include <stack>
 #include <vector>
 #include <cstdlib>
 #include <ctime>
@@ -11,7 +10,24 @@
 #include <cmath>
 #include <limits>
 #include <random>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <string_view>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+#include "ChessPiece.h"
 #include "ChessPuzzleSystem.h"
+#include "FenParser.h"
+#include "PgnReader.h"
+#include "NnueEvaluator.h"
 
 using namespace sf;
 using namespace std;
@@ -36,70 +52,388 @@ Sound startSound;
 Sound completingSound;
 
 bool gameOver = false;
-bool whiteKingMoved = false;
-bool blackKingMoved = false;
-bool whiteRookLeftMoved = false;
-bool whiteRookRightMoved = false;
-bool blackRookLeftMoved = false;
-bool blackRookRightMoved = false;
 
 // ==============
 //  CHESS LOGIC
 // ==============
 
 const int SIZE = 8;
-char boardLogic[SIZE][SIZE];
-bool whiteTurn = true;
 
 // =========================
-//  EN PASSANT VARIABLES
+//  PIECE LISTS
 // =========================
-int enPassantCol = -1;
-int enPassantRow = -1;
+// Squares are indexed r * 8 + c, so bit 0 is a8 and bit 63 is h1
+inline uint64_t squareBit(int r, int c) {
+    return 1ULL << (r * 8 + c);
+}
+inline int popCount(uint64_t b) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(b);
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+inline int lowestSquare(uint64_t b) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, b);
+    return (int)idx;
+#else
+    return __builtin_ctzll(b);
+#endif
+}
+
+// Piece slots follow the type order: P R N B Q K = 0..5 for White, 6..11 for Black
+struct PieceIndexTable {
+    int8_t idx[16];
+};
+constexpr PieceIndexTable makePieceIndexTable() {
+    PieceIndexTable t{};
+    for (int p = 0; p < 16; p++) {
+        int type = p & TYPE_MASK;
+        t.idx[p] = (int8_t)(type >= PAWN && type <= KING ? type - 1 + ((p & BLACK_BIT) ? 6 : 0) : -1);
+    }
+    return t;
+}
+constexpr PieceIndexTable PIECE_INDEX = makePieceIndexTable();
+inline int pieceIndex(Piece p) {
+    return PIECE_INDEX.idx[p & 15];
+}
+
+// Compile-time Zobrist keys (splitmix64) so hashing needs no start-up initialisation
+constexpr uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+struct ZobristKeys {
+    uint64_t piece[12][64];
+    uint64_t pawnSeed;      // starting pawn key, so "no pawns" never matches an empty slot
+    uint64_t blackToMove;
+    uint64_t castling[6];   // one per king/rook "has moved" flag still clear
+    uint64_t epFile[8];
+};
+constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys{};
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (int piece = 0; piece < 12; piece++)
+        for (int sq = 0; sq < 64; sq++)
+            keys.piece[piece][sq] = splitMix64(state);
+    keys.pawnSeed = splitMix64(state);
+    keys.blackToMove = splitMix64(state);
+    for (int i = 0; i < 6; i++) keys.castling[i] = splitMix64(state);
+    for (int f = 0; f < 8; f++) keys.epFile[f] = splitMix64(state);
+    return keys;
+}
+constexpr ZobristKeys ZOBRIST = makeZobristKeys();
+// Occupied squares per side plus king squares and piece counts, kept in step with
+// boardLogic by setSquare so engine loops visit pieces instead of all 64 squares
+struct PieceLists {
+    uint64_t occupied[2];   // [0] white, [1] black
+    int kingSq[2];          // -1 when the king is missing
+    int count[12];          // per piece slot
+    uint64_t key;           // Zobrist key of the piece placement
+};
+
+// =========================
+//  ENGINE
+// =========================
+// Strength picked in the AI menu
+enum AILevel {
+    EASY,
+    MEDIUM,
+    HARD
+};
+
+struct Move;
+struct TrialMove;
+struct GameState;
+struct MoveRecord;
+struct AttackMap;
+struct PawnEntry;
+struct EvalCacheEntry;
+struct SearchUndo;
+
+// A position with its history and move log, the evaluation caches and the search limits.
+// The game plays on one Engine; batch tools give every worker thread an Engine of its own.
+struct Engine {
+    bool whiteKingMoved = false;
+    bool blackKingMoved = false;
+    bool whiteRookLeftMoved = false;
+    bool whiteRookRightMoved = false;
+    bool blackRookLeftMoved = false;
+    bool blackRookRightMoved = false;
+
+    Piece boardLogic[SIZE][SIZE] = {};
+    bool whiteTurn = true;
+    PieceLists pieceLists = {};
+    int enPassantCol = -1;
+    int enPassantRow = -1;
+
+    // Key of the position before every move played, oldest first. The search pushes and
+    // pops its own line on top; entries past historyCount are kept for redo.
+    std::vector<uint64_t> keyHistory;
+    int historyCount = 0;
+    int halfmoveClock = 0;      // plies since the last capture or pawn move
+
+    Piece whiteCaptured[16] = {};   // stores captured white pieces
+    Piece blackCaptured[16] = {};   // stores captured black pieces
+    int whiteCapCount = 0;    // number of captured white pieces
+    int blackCapCount = 0;    // number of captured black pieces
+
+    // Moves of the current game; plies before plyCursor are on the board, the rest can be
+    // redone. snapshots[k] is the position at ply k * SNAPSHOT_INTERVAL.
+    std::vector<MoveRecord> moveLog;
+    int plyCursor = 0;
+    std::vector<GameState> snapshots;
+
+    // Where the log starts, for the fullmove number of exported FENs
+    int startFullmove = 1;
+    bool startWhiteToMove = true;
+
+    std::vector<PawnEntry> pawnHash;            // PAWN_HASH_SIZE entries
+    std::vector<EvalCacheEntry> evalCache;      // EVAL_CACHE_SIZE entries
+    // Used instead of evaluateBoardFull once weights are loaded, which only the game does
+    NnueEvaluator nnue;
+
+    // Searches that must answer in time set a deadline; once it passes, the search unwinds with
+    // meaningless scores and searchAborted tells the caller to discard them
+    std::chrono::steady_clock::time_point searchDeadline = std::chrono::steady_clock::time_point::max();
+    bool searchAborted = false;
+    unsigned searchNodes = 0;
+
+    Engine();
+
+    // Board and piece lists
+    void setSquare(int r, int c, Piece p);
+    void rebuildPieceLists();
+    TrialMove playTrialMove(int sx, int sy, int dx, int dy);
+    void undoTrialMove(const TrialMove& t);
+
+    // Position history
+    uint64_t gameKey(bool whiteToMove);
+    void pushPositionKey(uint64_t key);
+    void clearPositionHistory();
+    int repetitionCount(uint64_t key);
+    const char* drawByRule(bool whiteToMove);
+
+    // Move log
+    GameState captureGameState();
+    void restoreGameState(const GameState& s);
+    void prepareMoveLog();
+    void clearMoveLog();
+    void undoMove(bool aiThinking);
+    void redoMove(bool aiThinking);
+    uint8_t packCastlingFlags();
+    void unpackCastlingFlags(uint8_t flags);
+    MoveRecord playMove(int sx, int sy, int dx, int dy);
+    void unplayMove(const MoveRecord& m);
+    void replayMove(const MoveRecord& m);
+    MoveRecord logMove(int sx, int sy, int dx, int dy);
+    void makeMove(int sx, int sy, int dx, int dy);
+    void promoteLastMove(Piece promoted);
+    void seekToPly(int ply, bool aiThinking);
+
+    // Rules
+    void initializeBoardLogic();
+    bool isValidMove(int sx, int sy, int dx, int dy);
+    bool isValidPawnMove(int sx, int sy, int dx, int dy, Piece piece);
+    bool isvalidRookmove(int sx, int sy, int dx, int dy, Piece piece);
+    bool isValidBishopMove(int sx, int sy, int dx, int dy, Piece piece);
+    bool isvalidKinghtmove(int sx, int sy, int dx, int dy, Piece piece);
+    bool isValidQueenMove(int sx, int sy, int dx, int dy, Piece piece);
+    bool isvalidKingmove(int sx, int sy, int dx, int dy, Piece piece);
+    void findKing(Piece king, int& kx, int& ky);
+    bool kingexpose(int sx, int sy, int dx, int dy);
+    bool isSquareAttacked(int dx, int dy, bool byWhite);
+    bool isInCheck(bool whiteChecked);
+    bool hasAnyLegalMove(bool turn);
+    bool isCheckmate(bool whiteChecked);
+    bool isStalemate(bool whiteChecked);
+    bool kingExists(bool white);
+
+    // Attacks and exchanges
+    bool isEndgamePhase();
+    template<Side Us> int countAttackersOf(int r, int c);
+    int countAttackers(int r, int c, bool byWhite);
+    int fullStaticExchange(int sx, int sy, int dx, int dy);
+    bool isMoveTrulySafe(int sx, int sy, int dx, int dy);
+    uint64_t slidingAttacks(int r, int c, const int dirs[4][2]);
+    uint64_t pieceAttacks(int r, int c, Piece p);
+    template<Side Us> void buildAttackMap(AttackMap& map);
+    template<Side Them> bool squareAttackedBy(int r, int c);
+    template<Side Us> bool inCheck();
+    template<Side Us> uint64_t pseudoTargets(int r, int c, Piece p);
+    int evaluateThreats(const AttackMap& ours, const AttackMap& theirs);
+    int detectForks(const AttackMap& ours, const AttackMap& theirs);
+    uint64_t computePositionKey();
+
+    // Evaluation
+    const PawnEntry& probePawnHash(uint64_t key, uint64_t whitePawns, uint64_t blackPawns);
+    template<Side Us> int sideTerms(const AttackMap& ours, const AttackMap& theirs, const PawnEntry& pawns, bool endgame);
+    int evaluateBoardFull();
+    template<Side Us> int evaluateFor();
+    int evaluateBoard(bool aiIsWhite);
+
+    // Search
+    void simulateMove(const Move& m);
+    void makeSearchMove(const Move& m, SearchUndo& undo);
+    void unmakeSearchMove(const SearchUndo& undo);
+    template<Side Us> std::vector<Move> generateMoves();
+    template<Side Us> bool hasLegalMove();
+    std::vector<Move> generateAllMoves(bool turn);
+    int scoreMoveForOrdering(const Move& m, bool isWhite);
+    bool searchOutOfTime();
+    int quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth = 0);
+    int minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite);
+    Move findBestAIMove(AILevel level, bool aiIsWhite);
+    void applyAIMove(bool aiIsWhite);
+
+    // FEN and SAN
+    bool loadBoardFromFEN(std::string_view fen);
+    FenPosition currentFenPosition();
+    string boardToFEN();
+    template<Side Us> uint64_t legalOriginsTo(Piece piece, int toR, int toC);
+    uint64_t legalOrigins(Piece piece, int toR, int toC);
+    int writeSAN(int fromR, int fromC, int toR, int toC, Piece promotion, char* out);
+    string moveToSAN(int fromR, int fromC, int toR, int toC, Piece promotion = EMPTY);
+    bool parseSAN(std::string_view san, Move& move, Piece& promotion);
+    bool isLegalPackedMove(uint16_t m);
+    void playPackedMove(uint16_t m);
+
+    // Puzzles and PGN
+    bool compilePuzzleLine(const string& fen, const vector<string>& line, bool uci, vector<uint16_t>& moves);
+    int scoreRootMove(const Move& m, int depth, bool side, int alpha = -999999, int beta = 999999);
+    bool verifyPuzzleLine(const Puzzle& puzzle, string& reason);
+    bool replayPgnGame(const PgnGame& pgn, const std::function<void(int ply)>& onPosition = nullptr);
+};
+extern Engine game;
+
+void Engine::setSquare(int r, int c, Piece p) {
+    int sq = r * 8 + c;
+    Piece old = boardLogic[r][c];
+    if (old != EMPTY) {
+        int idx = pieceIndex(old);
+        int side = idx >= 6 ? 1 : 0;
+        pieceLists.occupied[side] &= ~(1ULL << sq);
+        pieceLists.count[idx]--;
+        pieceLists.key ^= ZOBRIST.piece[idx][sq];
+        if (pieceLists.kingSq[side] == sq) pieceLists.kingSq[side] = -1;
+    }
+    boardLogic[r][c] = p;
+    if (p != EMPTY) {
+        int idx = pieceIndex(p);
+        int side = idx >= 6 ? 1 : 0;
+        pieceLists.occupied[side] |= 1ULL << sq;
+        pieceLists.count[idx]++;
+        pieceLists.key ^= ZOBRIST.piece[idx][sq];
+        if (idx % 6 == 5) pieceLists.kingSq[side] = sq;
+    }
+}
+
+// After bulk writes to boardLogic (start position, FEN, restored snapshots)
+void Engine::rebuildPieceLists() {
+    memset(&pieceLists, 0, sizeof(pieceLists));
+    pieceLists.kingSq[0] = pieceLists.kingSq[1] = -1;
+    for (int sq = 0; sq < 64; sq++) {
+        Piece p = boardLogic[sq / 8][sq % 8];
+        if (p == EMPTY) continue;
+        int idx = pieceIndex(p);
+        int side = idx >= 6 ? 1 : 0;
+        pieceLists.occupied[side] |= 1ULL << sq;
+        pieceLists.count[idx]++;
+        pieceLists.key ^= ZOBRIST.piece[idx][sq];
+        if (idx % 6 == 5) pieceLists.kingSq[side] = sq;
+    }
+}
+
+// Play a move on the board and piece lists only, to test it; undone with undoTrialMove
+struct TrialMove {
+    int sx, sy, dx, dy;
+    Piece moved, captured;
+};
+
+TrialMove Engine::playTrialMove(int sx, int sy, int dx, int dy) {
+    TrialMove t = { sx, sy, dx, dy, boardLogic[sx][sy], boardLogic[dx][dy] };
+    setSquare(dx, dy, t.moved);
+    setSquare(sx, sy, EMPTY);
+    return t;
+}
+
+void Engine::undoTrialMove(const TrialMove& t) {
+    setSquare(t.sx, t.sy, t.moved);
+    setSquare(t.dx, t.dy, t.captured);
+}
+
+// =========================
+//  POSITION HISTORY
+// =========================
+
+// Piece placement plus side to move, castling flags and en passant file
+uint64_t Engine::gameKey(bool whiteToMove) {
+    uint64_t key = pieceLists.key;
+    if (!whiteToMove) key ^= ZOBRIST.blackToMove;
+    const bool moved[6] = { whiteKingMoved, whiteRookLeftMoved, whiteRookRightMoved,
+                            blackKingMoved, blackRookLeftMoved, blackRookRightMoved };
+    for (int i = 0; i < 6; i++)
+        if (!moved[i]) key ^= ZOBRIST.castling[i];
+    if (enPassantCol >= 0) key ^= ZOBRIST.epFile[enPassantCol];
+    return key;
+}
+
+void Engine::pushPositionKey(uint64_t key) {
+    keyHistory.resize(historyCount);
+    keyHistory.push_back(key);
+    historyCount++;
+}
+
+void Engine::clearPositionHistory() {
+    keyHistory.clear();
+    historyCount = 0;
+    halfmoveClock = 0;
+}
+
+// Earlier occurrences of the position, looking back only as far as the last
+// irreversible move and only at plies with the same side to move
+int Engine::repetitionCount(uint64_t key) {
+    int count = 0;
+    int stop = std::max(0, historyCount - halfmoveClock);
+    for (int i = historyCount - 2; i >= stop; i -= 2)
+        if (keyHistory[i] == key) count++;
+    return count;
+}
+
+// Threefold repetition or fifty moves without a capture or pawn move; nullptr if neither
+const char* Engine::drawByRule(bool whiteToMove) {
+    if (halfmoveClock >= 100) return "Draw by fifty-move rule!";
+    if (repetitionCount(gameKey(whiteToMove)) >= 2) return "Draw by threefold repetition!";
+    return nullptr;
+}
 
 Color lightColor = Color::White;
 Color darkColor = Color(100, 160, 100);
 
 
-char whiteCaptured[16];   // stores captured white pieces
-char blackCaptured[16];   // stores captured black pieces
-int whiteCapCount = 0;    // number of captured white pieces
-int blackCapCount = 0;    // number of captured white pieces
-
 // =============Globel variables for AI===========
-char aiBoard[8][8];
+Piece aiBoard[8][8];
 sf::Clock aiThinkClock;
 const float AI_TIME_LIMIT = 1.8f; 
 
 bool AIenabled = false;   // whether AI is enabled
 bool AIisWhite = false;   // if AI is white (true) or black (false)
 
-bool isValidMove(int sx, int sy, int dx, int dy);
-bool isValidPawnMove(int sx, int sy, int dx, int dy, char piece);
-bool isvalidRookmove(int sx, int sy, int dx, int dy, char p);
-bool isvalidKinghtmove(int sx, int sy, int dx, int dy, char p);
-bool isValidBishopMove(int sx, int sy, int dx, int dy, char p);
-bool isValidQueenMove(int sx, int sy, int dx, int dy, char p);
-bool isvalidKingmove(int sx, int sy, int dx, int dy, char p);
-bool kingexpose(int sx, int sy, int dx, int dy);
-void updateboard();
-void findKing(char kingChar, int& kx, int& ky);
-bool isSquareAttacked(int dx, int dy, bool byWhite);
-bool isInCheck(bool whiteTurn);
-bool hasAnyLegalMove(bool turn);
-bool isCheckmate(bool whiteTurn);
-bool isStalemate(bool whiteTurn);
-bool kingExists(bool white);
 
 
 struct Move
 {
     int sx, sy, dx, dy;
-    Move() : sx(-1), sy(-1), dx(-1), dy(-1) {}
-    Move(int a, int b, int c, int d) : sx(a), sy(b), dx(c), dy(d) {}
+    int promotion;      // piece type a pawn reaching the last row turns into
+    Move() : sx(-1), sy(-1), dx(-1), dy(-1), promotion(QUEEN) {}
+    Move(int a, int b, int c, int d, int promo = QUEEN) : sx(a), sy(b), dx(c), dy(d), promotion(promo) {}
 };
 struct GameState {
-    char board[8][8];
+    Piece board[8][8];
     bool whiteTurn;
 
     // Castling
@@ -115,14 +449,32 @@ struct GameState {
     int enPassantCol;
 
     // Captured pieces
-    char whiteCaptured[16];
-    char blackCaptured[16];
+    Piece whiteCaptured[16];
+    Piece blackCaptured[16];
     int whiteCapCount;
     int blackCapCount;
+
+    // Repetition / fifty-move bookkeeping
+    int halfmoveClock;
+    int historyCount;
+};
+// One played move with just enough to take it back or play it again
+struct MoveRecord {
+    uint8_t from, to;           // r * 8 + c
+    uint8_t capturedSq;         // differs from 'to' only for en passant
+    Piece moved;
+    Piece placed;               // differs from 'moved' after a promotion
+    Piece captured;             // EMPTY if nothing was taken
+    uint8_t castlingBefore;     // packed "has moved" flags, see packCastlingFlags
+    uint8_t castled;            // the rook moved as well
+    int8_t epRowBefore, epColBefore;
+    uint16_t halfmoveBefore;
 };
-std::stack<GameState> undoStack;
-std::stack<GameState> redoStack;
-GameState captureGameState() {
+
+// A full GameState is kept every SNAPSHOT_INTERVAL plies of the move log for seeking
+const int SNAPSHOT_INTERVAL = 32;
+
+GameState Engine::captureGameState() {
     GameState s;
     memcpy(s.board, boardLogic, sizeof(boardLogic));
 
@@ -142,10 +494,14 @@ GameState captureGameState() {
     s.whiteCapCount = whiteCapCount;
     s.blackCapCount = blackCapCount;
 
+    s.halfmoveClock = halfmoveClock;
+    s.historyCount = historyCount;
+
     return s;
 }
-void restoreGameState(const GameState& s) {
+void Engine::restoreGameState(const GameState& s) {
     memcpy(boardLogic, s.board, sizeof(boardLogic));
+    rebuildPieceLists();
     whiteTurn = s.whiteTurn;
     whiteKingMoved = s.whiteKingMoved;
     blackKingMoved = s.blackKingMoved;
@@ -162,29 +518,38 @@ void restoreGameState(const GameState& s) {
     whiteCapCount = s.whiteCapCount;
     blackCapCount = s.blackCapCount;
 
-    updateboard();
+    halfmoveClock = s.halfmoveClock;
+    historyCount = s.historyCount;
+}
+
+// Before a new move: drop the redo tail (truncating plain records is O(1)) and keep a
+// full snapshot when the ply starts a new interval
+void Engine::prepareMoveLog() {
+    moveLog.resize(plyCursor);
+    snapshots.resize(std::min<size_t>(snapshots.size(), plyCursor / SNAPSHOT_INTERVAL + 1));
+    if (plyCursor % SNAPSHOT_INTERVAL == 0 && (int)snapshots.size() == plyCursor / SNAPSHOT_INTERVAL)
+        snapshots.push_back(captureGameState());
 }
-void recordStateBeforeMove() {
-    undoStack.push(captureGameState());
-    while (!redoStack.empty()) redoStack.pop();
+void Engine::clearMoveLog() {
+    moveLog.clear();
+    snapshots.clear();
+    plyCursor = 0;
 }
-void undoMove(bool aiThinking) {
+void Engine::undoMove(bool aiThinking) {
     if (aiThinking) return;
-    if (undoStack.empty()) return;
+    if (plyCursor == 0) return;
 
-    redoStack.push(captureGameState());
-    GameState prev = undoStack.top();
-    undoStack.pop();
-    restoreGameState(prev);
+    const MoveRecord& m = moveLog[--plyCursor];
+    unplayMove(m);
+    whiteTurn = isWhitePiece(m.moved);
 }
-void redoMove(bool aiThinking) {
+void Engine::redoMove(bool aiThinking) {
     if (aiThinking) return;
-    if (redoStack.empty()) return;
+    if (plyCursor == (int)moveLog.size()) return;
 
-    undoStack.push(captureGameState());
-    GameState next = redoStack.top();
-    redoStack.pop();
-    restoreGameState(next);
+    const MoveRecord& m = moveLog[plyCursor++];
+    replayMove(m);
+    whiteTurn = !isWhitePiece(m.moved);
 }
 
 
@@ -195,41 +560,52 @@ bool isInsideBoard(int r, int c)
 
     return false;
 }
-void initializeBoardLogic()            //Set Character Board
+void Engine::initializeBoardLogic()            //Set Piece Board
 {
 
     for (int row = 0; row < SIZE; row++)
     {
         for (int col = 0; col < SIZE; col++)
         {
-            boardLogic[row][col] = ' ';
+            boardLogic[row][col] = EMPTY;
         }
     }
     for (int i = 0; i < SIZE; i++)
     {
-        boardLogic[6][i] = 'P'; // White-pawn at 2nd Row from Bottom
-        boardLogic[1][i] = 'p'; // Black-pawn at 2nd Row from Top
-    }
-    // for White Pieces (Upper-Case)
-    boardLogic[7][4] = 'K';
-    boardLogic[7][5] = 'B';
-    boardLogic[7][6] = 'N';
-    boardLogic[7][7] = 'R';
-    boardLogic[7][0] = 'R';
-    boardLogic[7][1] = 'N';
-    boardLogic[7][2] = 'B';
-    boardLogic[7][3] = 'Q';
-    //Black Pieces (Lower-case)
-    boardLogic[0][0] = 'r';
-    boardLogic[0][1] = 'n';
-    boardLogic[0][2] = 'b';
-    boardLogic[0][3] = 'q';
-    boardLogic[0][4] = 'k';
-    boardLogic[0][5] = 'b';
-    boardLogic[0][6] = 'n';
-    boardLogic[0][7] = 'r';
-}
-bool isValidMove(int sx, int sy, int dx, int dy)
+        boardLogic[6][i] = W_PAWN; // White-pawn at 2nd Row from Bottom
+        boardLogic[1][i] = B_PAWN; // Black-pawn at 2nd Row from Top
+    }
+    // for White Pieces
+    boardLogic[7][4] = W_KING;
+    boardLogic[7][5] = W_BISHOP;
+    boardLogic[7][6] = W_KNIGHT;
+    boardLogic[7][7] = W_ROOK;
+    boardLogic[7][0] = W_ROOK;
+    boardLogic[7][1] = W_KNIGHT;
+    boardLogic[7][2] = W_BISHOP;
+    boardLogic[7][3] = W_QUEEN;
+    //Black Pieces
+    boardLogic[0][0] = B_ROOK;
+    boardLogic[0][1] = B_KNIGHT;
+    boardLogic[0][2] = B_BISHOP;
+    boardLogic[0][3] = B_QUEEN;
+    boardLogic[0][4] = B_KING;
+    boardLogic[0][5] = B_BISHOP;
+    boardLogic[0][6] = B_KNIGHT;
+    boardLogic[0][7] = B_ROOK;
+
+    rebuildPieceLists();
+    clearPositionHistory();
+    clearMoveLog();
+    whiteCapCount = blackCapCount = 0;
+    whiteKingMoved = blackKingMoved = false;
+    whiteRookLeftMoved = whiteRookRightMoved = false;
+    blackRookLeftMoved = blackRookRightMoved = false;
+    enPassantRow = enPassantCol = -1;
+    startFullmove = 1;
+    startWhiteToMove = true;
+}
+bool Engine::isValidMove(int sx, int sy, int dx, int dy)
 {
 
 
@@ -238,68 +614,68 @@ bool isValidMove(int sx, int sy, int dx, int dy)
         return false;
     }
 
-    char piece = boardLogic[sx][sy];                                     //Check if the source square has a piece or not(empty)
-    if (piece == ' ')
+    Piece piece = boardLogic[sx][sy];                                     //Check if the source square has a piece or not(empty)
+    if (piece == EMPTY)
     {
         return false;
     }
 
 
-    if (whiteTurn && islower(piece))                                      //Check whether Valid Turn or Not
+    if (whiteTurn && isBlackPiece(piece))                                      //Check whether Valid Turn or Not
     {
         return false;
     }
-    if (!whiteTurn && isupper(piece))
+    if (!whiteTurn && isWhitePiece(piece))
     {
         return false;
     }
-    switch (tolower(piece))                                               //Check if the move is valid according to the piece type
+    switch (pieceType(piece))                                               //Check if the move is valid according to the piece type
     {
-    case 'p':
+    case PAWN:
         return isValidPawnMove(sx, sy, dx, dy, piece);
-    case 'r':
+    case ROOK:
         return isvalidRookmove(sx, sy, dx, dy, piece);
-    case 'n':
+    case KNIGHT:
         return isvalidKinghtmove(sx, sy, dx, dy, piece);
-    case 'b':
+    case BISHOP:
         return isValidBishopMove(sx, sy, dx, dy, piece);
-    case 'q':
+    case QUEEN:
         return isValidQueenMove(sx, sy, dx, dy, piece);
-    case 'k':
+    case KING:
         return isvalidKingmove(sx, sy, dx, dy, piece);
     }
     return false;
 }
-bool isValidPawnMove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isValidPawnMove(int sx, int sy, int dx, int dy, Piece piece)
 {
-    int dir = (isupper(piece)) ? -1 : +1;   // White (-1), Black (+1)
+    int dir = (isWhitePiece(piece)) ? -1 : +1;   // White (-1), Black (+1)
 
     // 1 — Forward 1 step
-    if (sy == dy && dx == sx + dir && boardLogic[dx][dy] == ' ')
+    if (sy == dy && dx == sx + dir && boardLogic[dx][dy] == EMPTY)
         return true;
 
     // 2 — Forward 2 steps (first move only)
     if (sy == dy && dx == sx + 2 * dir &&
-        boardLogic[sx + dir][sy] == ' ' &&
-        boardLogic[dx][dy] == ' ' &&
-        ((isupper(piece) && sx == 6) || (islower(piece) && sx == 1)))
+        boardLogic[sx + dir][sy] == EMPTY &&
+        boardLogic[dx][dy] == EMPTY &&
+        ((isWhitePiece(piece) && sx == 6) || (isBlackPiece(piece) && sx == 1)))
         return true;
 
     // 3 — Normal Capture
     if (abs(dy - sy) == 1 && dx == sx + dir &&
-        boardLogic[dx][dy] != ' ' &&
-        isupper(piece) != isupper(boardLogic[dx][dy]))
+        boardLogic[dx][dy] != EMPTY &&
+        isWhitePiece(piece) != isWhitePiece(boardLogic[dx][dy]))
         return true;
 
     // 4 — EN PASSANT
     if (abs(dy - sy) == 1 && dx == sx + dir &&
-        boardLogic[dx][dy] == ' ' &&                // destination empty
+        boardLogic[dx][dy] == EMPTY &&                // destination empty
         dx == enPassantRow && dy == enPassantCol)   // matches EP target
         return true;
 
     return false;
 }
-bool isvalidRookmove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isvalidRookmove(int sx, int sy, int dx, int dy, Piece piece)
 {
     if (dx != sx && dy != sy) // for same row because weather the row or column should be same
         return false;
@@ -323,23 +699,23 @@ bool isvalidRookmove(int sx, int sy, int dx, int dy, char piece)
     int x = sx + stepX, y = sy + stepY;
     while (y != dy || x != dx) // check one coordinate before the destination
     {
-        if (boardLogic[x][y] != ' ') // checking for whether the path is block or not 
+        if (boardLogic[x][y] != EMPTY) // checking for whether the path is block or not 
         {
             return false;
         }
         x += stepX, y += stepY; // increment or decrement for next checking
     }
-    if (boardLogic[dx][dy] == ' ') // if not space then return true for making move
+    if (boardLogic[dx][dy] == EMPTY) // if not space then return true for making move
     {
         return true;
     }
-    if (isupper(piece) != isupper(boardLogic[dx][dy]))
+    if (isWhitePiece(piece) != isWhitePiece(boardLogic[dx][dy]))
     {
         return true;
     }
     return false;
 }
-bool isValidBishopMove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isValidBishopMove(int sx, int sy, int dx, int dy, Piece piece)
 {
     if (abs(dx - sx) != abs(dy - sy)) // change in row == change in column for bishop (abs function make - to +)
     {
@@ -355,7 +731,7 @@ bool isValidBishopMove(int sx, int sy, int dx, int dy, char piece)
 
     while (x != dx && y != dy) // Checking for the move (not blocked, is-space )
     {
-        if (boardLogic[x][y] != ' ')
+        if (boardLogic[x][y] != EMPTY)
         {
             return false;
         }
@@ -364,28 +740,28 @@ bool isValidBishopMove(int sx, int sy, int dx, int dy, char piece)
     }
 
 
-    if (boardLogic[dx][dy] == ' ' || (isupper(piece) != isupper(boardLogic[dx][dy]))) //  if !same piece or not space then return true for making move
+    if (boardLogic[dx][dy] == EMPTY || (isWhitePiece(piece) != isWhitePiece(boardLogic[dx][dy]))) //  if !same piece or not space then return true for making move
     {
         return true;
     }
 
     return false;
 }
-bool isvalidKinghtmove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isvalidKinghtmove(int sx, int sy, int dx, int dy, Piece piece)
 {
     int x = abs(dx - sx), y = abs(dy - sy);
     if (!((x == 2 && y == 1) || (x == 1 && y == 2)))                            //knight can move L shape within the Board
     {                                                                           // so row =2 and column =1 or vise versa
         return false;
     }
-    if (boardLogic[dx][dy] == ' ' || (isupper(piece) != isupper(boardLogic[dx][dy])))
+    if (boardLogic[dx][dy] == EMPTY || (isWhitePiece(piece) != isWhitePiece(boardLogic[dx][dy])))
     {
         return true;
     }
     return false;
 
 }
-bool isValidQueenMove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isValidQueenMove(int sx, int sy, int dx, int dy, Piece piece)
 {
     //Queen can move Digonally or in a straight line
     if (abs(dx - sx) == abs(dy - sy))                                        // so I have a function of Rook and Bishop
@@ -402,10 +778,10 @@ bool isValidQueenMove(int sx, int sy, int dx, int dy, char piece)
         return false;
     }
 }
-bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
+bool Engine::isvalidKingmove(int sx, int sy, int dx, int dy, Piece piece)
 {
     // Can't capture own piece
-    if (boardLogic[dx][dy] != ' ' && isupper(piece) == isupper(boardLogic[dx][dy]))
+    if (boardLogic[dx][dy] != EMPTY && isWhitePiece(piece) == isWhitePiece(boardLogic[dx][dy]))
         return false;
 
     // Normal king move (one square)
@@ -413,13 +789,13 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
     {
         // IMPORTANT: Temporarily remove king from board
         // Otherwise the king blocks attacks from behind itself
-        boardLogic[sx][sy] = ' ';
+        setSquare(sx, sy, EMPTY);
 
         // Check if destination is attacked by opponent
         bool attacked = isSquareAttacked(dx, dy, !whiteTurn);
 
         // Restore king
-        boardLogic[sx][sy] = piece;
+        setSquare(sx, sy, piece);
 
         return !attacked;  // Valid only if NOT attacked
     }
@@ -429,7 +805,7 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
     // =======================
     if (sx == dx && abs(dy - sy) == 2)
     {
-        bool white = isupper(piece);
+        bool white = isWhitePiece(piece);
 
         if (white)
         {
@@ -438,8 +814,8 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
             // Kingside castling
             if (sy == 4 && dy == 6 &&
                 !whiteRookRightMoved &&
-                boardLogic[7][5] == ' ' &&
-                boardLogic[7][6] == ' ' &&
+                boardLogic[7][5] == EMPTY &&
+                boardLogic[7][6] == EMPTY &&
                 !isSquareAttacked(7, 4, false) &&
                 !isSquareAttacked(7, 5, false) &&
                 !isSquareAttacked(7, 6, false))
@@ -448,9 +824,9 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
             // Queenside castling
             if (sy == 4 && dy == 2 &&
                 !whiteRookLeftMoved &&
-                boardLogic[7][1] == ' ' &&
-                boardLogic[7][2] == ' ' &&
-                boardLogic[7][3] == ' ' &&
+                boardLogic[7][1] == EMPTY &&
+                boardLogic[7][2] == EMPTY &&
+                boardLogic[7][3] == EMPTY &&
                 !isSquareAttacked(7, 4, false) &&
                 !isSquareAttacked(7, 3, false) &&
                 !isSquareAttacked(7, 2, false))
@@ -463,8 +839,8 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
             // Kingside
             if (sy == 4 && dy == 6 &&
                 !blackRookRightMoved &&
-                boardLogic[0][5] == ' ' &&
-                boardLogic[0][6] == ' ' &&
+                boardLogic[0][5] == EMPTY &&
+                boardLogic[0][6] == EMPTY &&
                 !isSquareAttacked(0, 4, true) &&
                 !isSquareAttacked(0, 5, true) &&
                 !isSquareAttacked(0, 6, true))
@@ -473,9 +849,9 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
             // Queenside
             if (sy == 4 && dy == 2 &&
                 !blackRookLeftMoved &&
-                boardLogic[0][1] == ' ' &&
-                boardLogic[0][2] == ' ' &&
-                boardLogic[0][3] == ' ' &&
+                boardLogic[0][1] == EMPTY &&
+                boardLogic[0][2] == EMPTY &&
+                boardLogic[0][3] == EMPTY &&
                 !isSquareAttacked(0, 4, true) &&
                 !isSquareAttacked(0, 3, true) &&
                 !isSquareAttacked(0, 2, true))
@@ -486,339 +862,261 @@ bool isvalidKingmove(int sx, int sy, int dx, int dy, char piece)
     return false;
 }
 
-void findKing(char king, int& kx, int& ky)    //This Function Search for King Position on the Board
+void Engine::findKing(Piece king, int& kx, int& ky)    //King squares are tracked by the piece lists
 {
-    for (int r = 0; r < 8; r++)
-    {
-        for (int c = 0; c < 8; c++)
-        {
-            if (boardLogic[r][c] == king)
-            {
-                kx = r;
-                ky = c;
-                return;
-            }
-        }
-    }
+    int sq = pieceLists.kingSq[isWhitePiece(king) ? 0 : 1];
+    if (sq < 0) return;
+    kx = sq / 8;
+    ky = sq % 8;
 }
-bool kingexpose(int sx, int sy, int dx, int dy)
+bool Engine::kingexpose(int sx, int sy, int dx, int dy)
 {
-    char backupSrc = boardLogic[sx][sy];
-    char backupDst = boardLogic[dx][dy];
-
-    boardLogic[dx][dy] = backupSrc;
-    boardLogic[sx][sy] = ' ';
-
-    char kingChar = whiteTurn ? 'K' : 'k';
-
-    int kr = -1, kc = -1;
-    for (int r = 0; r < 8; r++)
-        for (int c = 0; c < 8; c++)
-            if (boardLogic[r][c] == kingChar)
-            {
-                kr = r;
-                kc = c;
-            }
+    TrialMove trial = playTrialMove(sx, sy, dx, dy);
 
+    int kingSq = pieceLists.kingSq[whiteTurn ? 0 : 1];
+    bool inCheck = isSquareAttacked(kingSq / 8, kingSq % 8, !whiteTurn);
 
-    bool inCheck = isSquareAttacked(kr, kc, !whiteTurn);
-
-
-    boardLogic[sx][sy] = backupSrc;
-    boardLogic[dx][dy] = backupDst;
+    undoTrialMove(trial);
 
     return inCheck;
 }
-bool isSquareAttacked(int dx, int dy, bool byWhite)
+bool Engine::isSquareAttacked(int dx, int dy, bool byWhite)
 {
-
-    bool old = whiteTurn;
-    whiteTurn = byWhite;
-
-    for (int r = 0; r < 8; r++)
-    {
-        for (int c = 0; c < 8; c++)
-        {
-            char p = boardLogic[r][c];
-            if (p == ' ')
-                continue;
-
-            if (byWhite && isupper(p) == false)
-                continue;
-            if (!byWhite && isupper(p) == true)
-                continue;
-
-            if (isValidMove(r, c, dx, dy))
-            {
-                whiteTurn = old;
-                return true;
-            }
-        }
-    }
-    whiteTurn = old;
-    return false;
+    return byWhite ? squareAttackedBy<WHITE>(dx, dy) : squareAttackedBy<BLACK>(dx, dy);
 }
-bool isInCheck(bool whiteChecked)
+bool Engine::isInCheck(bool whiteChecked)
 {
-    int kingX = -1, kingY = -1;
-
-    if (whiteChecked)                // WhiteChecked Provides the detail which King is actually Attacked
-        findKing('K', kingX, kingY); //Find the Location of White King if it is checked
-    else
-        findKing('k', kingX, kingY); //Find the Location of Black King if it is checked
-
-    if (kingX == -1)
-        return false; // safety
-
-    return isSquareAttacked(kingX, kingY, !whiteChecked); // Check the King Square is Under Attack or Not
+    return whiteChecked ? inCheck<WHITE>() : inCheck<BLACK>(); // WhiteChecked Provides the detail which King is actually Attacked
 }
-bool hasAnyLegalMove(bool turn)
+bool Engine::hasAnyLegalMove(bool turn)
 {
-    bool old = whiteTurn;
-    whiteTurn = turn;
-
-    for (int sx = 0; sx < 8; sx++)
-    {
-        for (int sy = 0; sy < 8; sy++)
-        {
-            char p = boardLogic[sx][sy];
-            if (p == ' ') continue;
-
-            if (turn && islower(p))
-                continue;
-            if (!turn && isupper(p))
-                continue;
-
-            for (int dx = 0; dx < 8; dx++)
-            {
-                for (int dy = 0; dy < 8; dy++)
-                {
-                    if (isValidMove(sx, sy, dx, dy))
-                    {
-
-                        char backup = boardLogic[dx][dy]; //Temporary move to Destination for Check still in check or Not
-                        char self = boardLogic[sx][sy];
-
-                        boardLogic[dx][dy] = self;
-                        boardLogic[sx][sy] = ' ';
-
-                        bool stillCheck = isInCheck(turn);
-
-                        // undo
-                        boardLogic[sx][sy] = self;
-                        boardLogic[dx][dy] = backup;
-
-                        if (!stillCheck)
-                        {
-                            whiteTurn = old;
-                            return true;
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    whiteTurn = old;
-    return false;
+    return turn ? hasLegalMove<WHITE>() : hasLegalMove<BLACK>();
 }
-bool isCheckmate(bool whiteChecked)
+bool Engine::isCheckmate(bool whiteChecked)
 {
     if (isInCheck(whiteChecked) && !hasAnyLegalMove(whiteChecked))
         return true;
     return false;
 }
-bool isStalemate(bool whiteChecked)
+bool Engine::isStalemate(bool whiteChecked)
 {
     // Stalemate>> NOT in check, but dont have any legal moves.
     if (!isInCheck(whiteChecked) && !hasAnyLegalMove(whiteChecked))
         return true;
     return false;
 }
-bool kingExists(bool white)
+bool Engine::kingExists(bool white)
 {
-    char kc;
-    if (white)
-    {
-        kc = 'K';
-    }
-    else
-    {
-        kc = 'k';
-    }
-    for (int r = 0; r < 8; ++r)
-    {
-        for (int c = 0; c < 8; ++c)
-        {
-            if (boardLogic[r][c] == kc)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    return pieceLists.kingSq[white ? 0 : 1] >= 0;
+}
+// Castling flags as bits, in the order of ZOBRIST.castling
+uint8_t Engine::packCastlingFlags() {
+    return (uint8_t)(whiteKingMoved << 0 | whiteRookLeftMoved << 1 | whiteRookRightMoved << 2 |
+                     blackKingMoved << 3 | blackRookLeftMoved << 4 | blackRookRightMoved << 5);
+}
+void Engine::unpackCastlingFlags(uint8_t flags) {
+    whiteKingMoved = (flags >> 0) & 1;
+    whiteRookLeftMoved = (flags >> 1) & 1;
+    whiteRookRightMoved = (flags >> 2) & 1;
+    blackKingMoved = (flags >> 3) & 1;
+    blackRookLeftMoved = (flags >> 4) & 1;
+    blackRookRightMoved = (flags >> 5) & 1;
 }
-void makeMove(int sx, int sy, int dx, int dy)
+
+// Plays a move on the game state without sounds or logging and returns its undo record
+MoveRecord Engine::playMove(int sx, int sy, int dx, int dy)
 {
-    char piece = boardLogic[sx][sy];
+    Piece piece = boardLogic[sx][sy];
+
+    MoveRecord m;
+    m.from = (uint8_t)(sx * 8 + sy);
+    m.to = (uint8_t)(dx * 8 + dy);
+    m.capturedSq = m.to;
+    m.moved = m.placed = piece;
+    m.captured = boardLogic[dx][dy];
+    m.castlingBefore = packCastlingFlags();
+    m.castled = 0;
+    m.epRowBefore = (int8_t)enPassantRow;
+    m.epColBefore = (int8_t)enPassantCol;
+    m.halfmoveBefore = (uint16_t)halfmoveClock;
+
+    // =========================
+    // Repetition & fifty-move bookkeeping
+    // =========================
+    pushPositionKey(gameKey(isWhitePiece(piece)));
+    if (pieceType(piece) == PAWN || boardLogic[dx][dy] != EMPTY) halfmoveClock = 0;
+    else halfmoveClock++;
 
     // =========================
     // Track king & rook movement
     // =========================
-    if (piece == 'K') whiteKingMoved = true;
-    if (piece == 'k') blackKingMoved = true;
+    if (piece == W_KING) whiteKingMoved = true;
+    if (piece == B_KING) blackKingMoved = true;
 
-    if (piece == 'R') {
+    if (piece == W_ROOK) {
         if (sx == 7 && sy == 0) whiteRookLeftMoved = true;
         if (sx == 7 && sy == 7) whiteRookRightMoved = true;
     }
-    if (piece == 'r') {
+    if (piece == B_ROOK) {
         if (sx == 0 && sy == 0) blackRookLeftMoved = true;
         if (sx == 0 && sy == 7) blackRookRightMoved = true;
     }
+    // A rook taken on its corner can no longer castle either
+    if (m.captured == W_ROOK && dx == 7) {
+        if (dy == 0) whiteRookLeftMoved = true;
+        if (dy == 7) whiteRookRightMoved = true;
+    }
+    if (m.captured == B_ROOK && dx == 0) {
+        if (dy == 0) blackRookLeftMoved = true;
+        if (dy == 7) blackRookRightMoved = true;
+    }
 
     // =========================
     // EN PASSANT CAPTURE
     // =========================
-    if (tolower(piece) == 'p' && dx == enPassantRow && dy == enPassantCol)
+    if (pieceType(piece) == PAWN && dx == enPassantRow && dy == enPassantCol)
     {
-        if (isupper(piece)) { // White pawn captures black
-            if (boardLogic[dx + 1][dy] != ' ') {
-                blackCaptured[blackCapCount++] = boardLogic[dx + 1][dy];
-                boardLogic[dx + 1][dy] = ' ';
-                castlingSound.play();
-            }
-        }
-        else { // Black pawn captures white
-            if (boardLogic[dx - 1][dy] != ' ') {
-                whiteCaptured[whiteCapCount++] = boardLogic[dx - 1][dy];
-                boardLogic[dx - 1][dy] = ' ';
-                castlingSound.play();
-            }
+        int victimRow = isWhitePiece(piece) ? dx + 1 : dx - 1;
+        if (boardLogic[victimRow][dy] != EMPTY) {
+            m.captured = boardLogic[victimRow][dy];
+            m.capturedSq = (uint8_t)(victimRow * 8 + dy);
+            setSquare(victimRow, dy, EMPTY);
         }
     }
 
     // =========================
-    // NORMAL CAPTURE
+    // CAPTURED LISTS
     // =========================
-    if (boardLogic[dx][dy] != ' ') {
-        if (isupper(boardLogic[dx][dy])) whiteCaptured[whiteCapCount++] = boardLogic[dx][dy];
-        else blackCaptured[blackCapCount++] = boardLogic[dx][dy];
-
-        captureSound.play();
+    if (m.captured != EMPTY) {
+        if (isWhitePiece(m.captured)) whiteCaptured[whiteCapCount++] = m.captured;
+        else blackCaptured[blackCapCount++] = m.captured;
     }
 
     // =========================
     // Move piece
     // =========================
-    boardLogic[dx][dy] = piece;
-    boardLogic[sx][sy] = ' ';
+    setSquare(dx, dy, piece);
+    setSquare(sx, sy, EMPTY);
 
     // =========================
     // DOUBLE PAWN MOVE (Enable En Passant)
     // =========================
     enPassantRow = -1;
     enPassantCol = -1;
-    if (piece == 'P' && sx == 6 && dx == 4) { enPassantRow = 5; enPassantCol = sy; }
-    else if (piece == 'p' && sx == 1 && dx == 3) { enPassantRow = 2; enPassantCol = sy; }
+    if (piece == W_PAWN && sx == 6 && dx == 4) { enPassantRow = 5; enPassantCol = sy; }
+    else if (piece == B_PAWN && sx == 1 && dx == 3) { enPassantRow = 2; enPassantCol = sy; }
 
     // =========================
     // CASTLING EXECUTION
     // =========================
-    if (piece == 'K') {
-        if (sy == 4 && dy == 6) { // King side
-            boardLogic[7][5] = 'R';
-            boardLogic[7][7] = ' ';
-            castlingSound.play();
+    if (pieceType(piece) == KING && sy == 4 && (dy == 6 || dy == 2)) {
+        int row = isWhitePiece(piece) ? 7 : 0;
+        Piece rook = makePiece(ROOK, isWhitePiece(piece));
+        if (dy == 6) { // King side
+            setSquare(row, 5, rook);
+            setSquare(row, 7, EMPTY);
         }
-        if (sy == 4 && dy == 2) { // Queen side
-            boardLogic[7][3] = 'R';
-            boardLogic[7][0] = ' ';
-            castlingSound.play();
+        else { // Queen side
+            setSquare(row, 3, rook);
+            setSquare(row, 0, EMPTY);
         }
+        m.castled = 1;
     }
 
-    if (piece == 'k') {
-        if (sy == 4 && dy == 6) { // King side
-            boardLogic[0][5] = 'r';
-            boardLogic[0][7] = ' ';
-            castlingSound.play();
+    return m;
+}
+
+void Engine::unplayMove(const MoveRecord& m)
+{
+    int sx = m.from / 8, sy = m.from % 8;
+    int dx = m.to / 8, dy = m.to % 8;
+
+    if (m.castled) {
+        int row = isWhitePiece(m.moved) ? 7 : 0;
+        Piece rook = makePiece(ROOK, isWhitePiece(m.moved));
+        if (dy == 6) {
+            setSquare(row, 7, rook);
+            setSquare(row, 5, EMPTY);
         }
-        if (sy == 4 && dy == 2) { // Queen side
-            boardLogic[0][3] = 'r';
-            boardLogic[0][0] = ' ';
-            castlingSound.play();
+        else {
+            setSquare(row, 0, rook);
+            setSquare(row, 3, EMPTY);
         }
     }
 
-    // =========================
-    // Done
-    // =========================
-    updateboard(); // Refresh display after move
-}
+    setSquare(dx, dy, EMPTY);
+    setSquare(sx, sy, m.moved);
 
-// ===========================
-//     SFML BOARD HANDLING
-// ===========================
+    if (m.captured != EMPTY) {
+        setSquare(m.capturedSq / 8, m.capturedSq % 8, m.captured);
+        if (isWhitePiece(m.captured)) whiteCapCount--;
+        else blackCapCount--;
+    }
 
-int boardArr[8][8];
+    unpackCastlingFlags(m.castlingBefore);
+    enPassantRow = m.epRowBefore;
+    enPassantCol = m.epColBefore;
+    halfmoveClock = m.halfmoveBefore;
+    historyCount--;
+}
 
-int convert(char Piece) //+for Upper(white Piece) -for Lower(black Piece)
+void Engine::replayMove(const MoveRecord& m)
 {
-    //when we are going to perform move it is easy to campare integers rather than characters so....
-    switch (Piece)
-    {
-        //1 for white Pawn & so on
-    case 'P': return 1;
-    case 'R': return 2;
-    case 'N': return 3;
-    case 'B': return 4;
-    case 'Q': return 5;
-    case 'K': return 6;
-        //-1 for Black Pawn & so on
-    case 'p': return -1;
-    case 'r': return -2;
-    case 'n': return -3;
-    case 'b': return -4;
-    case 'q': return -5;
-    case 'k': return -6;
-    }
-    return 0; //for spaces it return 0
-}
-
-char backConvert(int id)
+    playMove(m.from / 8, m.from % 8, m.to / 8, m.to % 8);
+    if (m.placed != m.moved) setSquare(m.to / 8, m.to % 8, m.placed);
+}
+
+// Played and kept in the move log, without sounds (replayed games)
+MoveRecord Engine::logMove(int sx, int sy, int dx, int dy)
 {
-    //when board update after move it assign the charater to the pieces (texture requires character not digit as our image name is Character)
-    switch (id)
-    {
-    case 1: return 'P';
-    case 2: return 'R';
-    case 3: return 'N';
-    case 4: return 'B';
-    case 5: return 'Q';
-    case 6: return 'K';
+    prepareMoveLog();
+    MoveRecord m = playMove(sx, sy, dx, dy);
+    moveLog.push_back(m);
+    plyCursor++;
+    return m;
+}
 
-    case -1: return 'p';
-    case -2: return 'r';
-    case -3: return 'n';
-    case -4: return 'b';
-    case -5: return 'q';
-    case -6: return 'k';
-    }
-    return ' '; //for 0 it returns spaces
+// Played by the game: sounds, and a record in the move log
+void Engine::makeMove(int sx, int sy, int dx, int dy)
+{
+    MoveRecord m = logMove(sx, sy, dx, dy);
+
+    if (m.castled || m.capturedSq != m.to) castlingSound.play();
+    else if (m.captured != EMPTY) captureSound.play();
 }
 
-void updateboard()// It actually convert the board into Digital-One
+// The piece a pawn on the last row turns into, recorded so redo repeats the choice
+void Engine::promoteLastMove(Piece promoted)
 {
-    for (int r = 0; r < 8; r++)
-    {
-        for (int c = 0; c < 8; c++)
-        {
-            boardArr[r][c] = convert(boardLogic[r][c]);
-        }
+    MoveRecord& m = moveLog[plyCursor - 1];
+    setSquare(m.to / 8, m.to % 8, promoted);
+    m.placed = promoted;
+}
+
+// Jumps to any ply of the log. Starts from the nearest snapshot at or below the target,
+// or from the current ply when that is closer, so at most SNAPSHOT_INTERVAL - 1 moves
+// are replayed however long the game is.
+void Engine::seekToPly(int ply, bool aiThinking)
+{
+    if (aiThinking) return;
+    ply = std::max(0, std::min(ply, (int)moveLog.size()));
+
+    int k = std::min(ply / SNAPSHOT_INTERVAL, (int)snapshots.size() - 1);
+    if (k >= 0 && ply - k * SNAPSHOT_INTERVAL < std::abs(ply - plyCursor)) {
+        restoreGameState(snapshots[k]);
+        plyCursor = k * SNAPSHOT_INTERVAL;
     }
+    while (plyCursor > ply) unplayMove(moveLog[--plyCursor]);
+    while (plyCursor < ply) replayMove(moveLog[plyCursor++]);
+
+    if (plyCursor > 0) whiteTurn = !isWhitePiece(moveLog[plyCursor - 1].moved);
+    else if (!snapshots.empty()) whiteTurn = snapshots[0].whiteTurn;
 }
 
+// ===========================
+//     SFML BOARD HANDLING
+// ===========================
+
 // ==========
 // DRAWING
 // ==========
@@ -842,7 +1140,7 @@ void drawBoard(RenderWindow& win, RectangleShape& box, int dragR, int dragC, int
             // Highlight the square under mouse while dragging
             if (r == hoverR && c == hoverC && dragR != -1 && dragC != -1)
             {
-                if (isValidMove(dragR, dragC, r, c))
+                if (game.isValidMove(dragR, dragC, r, c))
                     box.setFillColor(validMoveColor);
                 else
                     box.setFillColor(invalidMoveColor);
@@ -874,14 +1172,11 @@ void drawPieces(RenderWindow& win,Texture W[], Texture B[],int skipR, int skipC)
             if (r == skipR && c == skipC)
                 continue;
 
-            int id = boardArr[r][c];
-            if (id == 0)
+            Piece p = game.boardLogic[r][c];
+            if (p == EMPTY)
                 continue;
 
-            if (id > 0)
-                s.setTexture(W[id - 1]);
-            else
-                s.setTexture(B[-id - 1]);
+            s.setTexture(isWhitePiece(p) ? W[pieceType(p) - 1] : B[pieceType(p) - 1]);
 
             s.setPosition(c * tileW + offX,
                 r * tileH + offY);
@@ -910,10 +1205,9 @@ void drawCaptured(RenderWindow& win, Texture W[], Texture B[])
     win.draw(bgBlack);
 
     // White captured pieces (shown on right)
-    for (int i = 0; i < whiteCapCount; i++)
+    for (int i = 0; i < game.whiteCapCount; i++)
     {
-        char c = whiteCaptured[i];
-        int idx = convert(c) - 1;
+        int idx = pieceType(game.whiteCaptured[i]) - 1;
         if (idx >= 0 && idx < 6)
         {
             s.setTexture(W[idx]);
@@ -923,10 +1217,9 @@ void drawCaptured(RenderWindow& win, Texture W[], Texture B[])
     }
 
     // Black captured pieces (shown on left)
-    for (int i = 0; i < blackCapCount; i++)
+    for (int i = 0; i < game.blackCapCount; i++)
     {
-        char c = blackCaptured[i];
-        int idx = -convert(c) - 1;
+        int idx = pieceType(game.blackCaptured[i]) - 1;
         if (idx >= 0 && idx < 6)
         {
             s.setTexture(B[idx]);
@@ -935,7 +1228,7 @@ void drawCaptured(RenderWindow& win, Texture W[], Texture B[])
         }
     }
 }
-char showPromotionMenu(RenderWindow& window, bool white, Texture W[], Texture B[])
+Piece showPromotionMenu(RenderWindow& window, bool white, Texture W[], Texture B[])
 {
     RectangleShape menuBG(Vector2f(tileW * 4, tileH));
     menuBG.setFillColor(Color(200, 200, 200));
@@ -978,8 +1271,7 @@ char showPromotionMenu(RenderWindow& window, bool white, Texture W[], Texture B[
                 int idx = (mx - startX) / tileW;
                 if (idx >= 0 && idx < 4)
                 {
-                    if (white) return (idx == 0 ? 'R' : idx == 1 ? 'N' : idx == 2 ? 'B' : 'Q');
-                    else return (idx == 0 ? 'r' : idx == 1 ? 'n' : idx == 2 ? 'b' : 'q');
+                    return makePiece(ROOK + idx, white); // menu follows the texture order R N B Q
                 }
             }
         }
@@ -1015,17 +1307,11 @@ float dragOffsetX, dragOffsetY;
 // 
 // ===========================
 
-enum AILevel {
-    EASY,
-    MEDIUM,
-    HARD
-};
-
 AILevel aiDifficulty = MEDIUM;
 
 // ===================== PIECE-SQUARE TABLES =====================
 
-const int PAWN_TABLE[8][8] = {
+constexpr int PAWN_TABLE[8][8] = {
     {  0,  0,  0,  0,  0,  0,  0,  0 },
     { 50, 50, 50, 50, 50, 50, 50, 50 },
     { 10, 10, 20, 30, 30, 20, 10, 10 },
@@ -1035,7 +1321,7 @@ const int PAWN_TABLE[8][8] = {
     {  5, 10, 10,-20,-20, 10, 10,  5 },
     {  0,  0,  0,  0,  0,  0,  0,  0 }
 };
-const int KNIGHT_TABLE[8][8] = {
+constexpr int KNIGHT_TABLE[8][8] = {
     {-50,-40,-30,-30,-30,-30,-40,-50 },
     {-40,-20,  0,  0,  0,  0,-20,-40 },
     {-30,  0, 10, 15, 15, 10,  0,-30 },
@@ -1045,7 +1331,7 @@ const int KNIGHT_TABLE[8][8] = {
     {-40,-20,  0,  5,  5,  0,-20,-40 },
     {-50,-40,-30,-30,-30,-30,-40,-50 }
 };
-const int BISHOP_TABLE[8][8] = {
+constexpr int BISHOP_TABLE[8][8] = {
     {-20,-10,-10,-10,-10,-10,-10,-20 },
     {-10,  0,  0,  0,  0,  0,  0,-10 },
     {-10,  0,  5, 10, 10,  5,  0,-10 },
@@ -1055,7 +1341,7 @@ const int BISHOP_TABLE[8][8] = {
     {-10,  5,  0,  0,  0,  0,  5,-10 },
     {-20,-10,-10,-10,-10,-10,-10,-20 }
 };
-const int ROOK_TABLE[8][8] = {
+constexpr int ROOK_TABLE[8][8] = {
     {  0,  0,  0,  0,  0,  0,  0,  0 },
     {  5, 10, 10, 10, 10, 10, 10,  5 },
     { -5,  0,  0,  0,  0,  0,  0, -5 },
@@ -1065,7 +1351,7 @@ const int ROOK_TABLE[8][8] = {
     { -5,  0,  0,  0,  0,  0,  0, -5 },
     {  0,  0,  0,  5,  5,  0,  0,  0 }
 };
-const int QUEEN_TABLE[8][8] = {
+constexpr int QUEEN_TABLE[8][8] = {
     {-20,-10,-10, -5, -5,-10,-10,-20 },
     {-10,  0,  0,  0,  0,  0,  0,-10 },
     {-10,  0,  5,  5,  5,  5,  0,-10 },
@@ -1075,7 +1361,7 @@ const int QUEEN_TABLE[8][8] = {
     {-10,  0,  5,  0,  0,  0,  0,-10 },
     {-20,-10,-10, -5, -5,-10,-10,-20 }
 };
-const int KING_MIDDLE_TABLE[8][8] = {
+constexpr int KING_MIDDLE_TABLE[8][8] = {
     {-30,-40,-40,-50,-50,-40,-40,-30 },
     {-30,-40,-40,-50,-50,-40,-40,-30 },
     {-30,-40,-40,-50,-50,-40,-40,-30 },
@@ -1085,7 +1371,7 @@ const int KING_MIDDLE_TABLE[8][8] = {
     { 20, 20,  0,  0,  0,  0, 20, 20 },
     { 20, 30, 10,  0,  0, 10, 30, 20 }
 };
-const int KING_END_TABLE[8][8] = {
+constexpr int KING_END_TABLE[8][8] = {
     {-50,-40,-30,-20,-20,-30,-40,-50 },
     {-30,-20,-10,  0,  0,-10,-20,-30 },
     {-30,-10, 20, 30, 30, 20,-10,-30 },
@@ -1097,97 +1383,77 @@ const int KING_END_TABLE[8][8] = {
 };
 // ===================== UTILITY FUNCTIONS =====================
 
-void copyBoard(char src[8][8], char dst[8][8]) {
+void copyBoard(const Piece src[8][8], Piece dst[8][8]) {
     memcpy(dst, src, sizeof(char) * 64);
 }   
-int pieceValue(char p) {
-    switch (tolower(p)) {
-    case 'p': return 100;
-    case 'n': return 320;
-    case 'b': return 330;
-    case 'r': return 500;
-    case 'q': return 900;
-    case 'k': return 20000;
+int pieceValue(Piece p) {
+    switch (pieceType(p)) {
+    case PAWN: return 100;
+    case KNIGHT: return 320;
+    case BISHOP: return 330;
+    case ROOK: return 500;
+    case QUEEN: return 900;
+    case KING: return 20000;
     default: return 0;
     }
 }
-bool isEndgamePhase() {
-    int queens = 0, rooks = 0;
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            char p = tolower(boardLogic[r][c]);
-            if (p == 'q') queens++;
-            else if (p == 'r') rooks++;
-        }
-    }
+bool Engine::isEndgamePhase() {
+    int queens = pieceLists.count[pieceIndex(W_QUEEN)] + pieceLists.count[pieceIndex(B_QUEEN)];
+    int rooks = pieceLists.count[pieceIndex(W_ROOK)] + pieceLists.count[pieceIndex(B_ROOK)];
     return queens == 0 || (queens <= 1 && rooks == 0);
 }
-bool isOpenFile(int col) {
-    for (int r = 0; r < 8; r++) {
-        if (tolower(boardLogic[r][col]) == 'p') return false;
-    }
-    return true;
-}
 
 // ===================== CRITICAL: ATTACK/DEFENSE DETECTION =====================
 
 // Count attackers with FULL exchange simulation
-int countAttackers(int r, int c, bool byWhite) {
+template<Side Us>
+int Engine::countAttackersOf(int r, int c) {
     int count = 0;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            char p = boardLogic[i][j];
-            if (p == ' ') continue;
-            if ((isupper(p) != 0) != byWhite) continue;
-
-            // Temporarily move attacker and check if move is valid
-            char backup = boardLogic[r][c];
-            char attacker = boardLogic[i][j];
+    for (uint64_t b = pieceLists.occupied[Us]; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        int i = sq / 8, j = sq % 8;
 
-            if (isValidMove(i, j, r, c)) {
-                // Simulate capture to check if it's a valid attack
-                boardLogic[r][c] = attacker;
-                boardLogic[i][j] = ' ';
+        if (pseudoTargets<Us>(i, j, boardLogic[i][j]) & squareBit(r, c)) {
+            // Simulate capture to check if it's a valid attack
+            TrialMove trial = playTrialMove(i, j, r, c);
 
-                // Check if this puts own king in check
-                bool selfCheck = isInCheck(byWhite);
+            // Check if this puts own king in check
+            bool selfCheck = inCheck<Us>();
 
-                // Restore
-                boardLogic[i][j] = attacker;
-                boardLogic[r][c] = backup;
+            // Restore
+            undoTrialMove(trial);
 
-                if (!selfCheck) count++;
-            }
+            if (!selfCheck) count++;
         }
     }
     return count;
 }
+int Engine::countAttackers(int r, int c, bool byWhite) {
+    return byWhite ? countAttackersOf<WHITE>(r, c) : countAttackersOf<BLACK>(r, c);
+}
 
 // CRITICAL: Full Static Exchange Evaluation
-int fullStaticExchange(int sx, int sy, int dx, int dy) {
-    char attacker = boardLogic[sx][sy];
-    char victim = boardLogic[dx][dy];
+int Engine::fullStaticExchange(int sx, int sy, int dx, int dy) {
+    Piece attacker = boardLogic[sx][sy];
+    Piece victim = boardLogic[dx][dy];
 
-    if (victim == ' ') return 0;
-    if (attacker == ' ') return 0;
+    if (victim == EMPTY) return 0;
+    if (attacker == EMPTY) return 0;
 
-    bool isWhite = (isupper(attacker) != 0);
+    bool isWhite = isWhitePiece(attacker);
 
     // Material gained from capture
     int gain = pieceValue(victim);
 
     // Simulate the capture
-    char backup[8][8];
-    copyBoard(boardLogic, backup);
-    boardLogic[dx][dy] = attacker;
-    boardLogic[sx][sy] = ' ';
+    TrialMove trial = playTrialMove(sx, sy, dx, dy);
 
     // How many can recapture?
     int enemyAttackers = countAttackers(dx, dy, !isWhite);
     int ourDefenders = countAttackers(dx, dy, isWhite);
 
     // Restore board
-    copyBoard(backup, boardLogic);
+    undoTrialMove(trial);
 
     // If enemy can recapture
     if (enemyAttackers > 0) {
@@ -1204,19 +1470,18 @@ int fullStaticExchange(int sx, int sy, int dx, int dy) {
 }
 
 // CRITICAL: Is this move truly safe?
-bool isMoveTrulySafe(int sx, int sy, int dx, int dy) {
-    char mover = boardLogic[sx][sy];
-    char victim = boardLogic[dx][dy];
+bool Engine::isMoveTrulySafe(int sx, int sy, int dx, int dy) {
+    Piece mover = boardLogic[sx][sy];
+    Piece victim = boardLogic[dx][dy];
 
-    if (mover == ' ') return false;
+    if (mover == EMPTY) return false;
 
-    bool isWhite = (isupper(mover) != 0);
+    bool isWhite = isWhitePiece(mover);
     int moverValue = pieceValue(mover);
-    int victimValue = victim == ' ' ? 0 : pieceValue(victim);
+    int victimValue = victim == EMPTY ? 0 : pieceValue(victim);
 
     // Simulate move
-    boardLogic[dx][dy] = mover;
-    boardLogic[sx][sy] = ' ';
+    TrialMove trial = playTrialMove(sx, sy, dx, dy);
 
     // Check if we put ourselves in check
     bool inCheck = isInCheck(isWhite);
@@ -1231,8 +1496,7 @@ bool isMoveTrulySafe(int sx, int sy, int dx, int dy) {
     }
 
     // Undo move
-    boardLogic[sx][sy] = mover;
-    boardLogic[dx][dy] = victim;
+    undoTrialMove(trial);
 
     // If move puts us in check, it's illegal (should be caught earlier)
     if (inCheck) return false;
@@ -1240,7 +1504,7 @@ bool isMoveTrulySafe(int sx, int sy, int dx, int dy) {
     // CRITICAL CHECKS:
 
     // 1. If it's a capture
-    if (victim != ' ') {
+    if (victim != EMPTY) {
         // Good: Taking equal or better piece
         if (victimValue >= moverValue) {
             // But make sure we won't be recaptured for more loss
@@ -1274,151 +1538,594 @@ bool isMoveTrulySafe(int sx, int sy, int dx, int dy) {
     return true;
 }
 
-// ===================== THREAT EVALUATION =====================
+// ===================== ATTACK MAPS =====================
+
+const int KNIGHT_STEPS[8][2] = { {-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1} };
+const int KING_STEPS[8][2] = { {-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1} };
+const int ROOK_DIRS[4][2] = { {-1,0},{1,0},{0,-1},{0,1} };
+const int BISHOP_DIRS[4][2] = { {-1,-1},{-1,1},{1,-1},{1,1} };
+
+uint64_t Engine::slidingAttacks(int r, int c, const int dirs[4][2]) {
+    uint64_t attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int x = r + dirs[d][0], y = c + dirs[d][1];
+        while (isInsideBoard(x, y)) {
+            attacks |= squareBit(x, y);
+            if (boardLogic[x][y] != EMPTY) break; // first blocker is attacked, nothing behind it
+            x += dirs[d][0];
+            y += dirs[d][1];
+        }
+    }
+    return attacks;
+}
 
-int evaluateThreats(bool ourColor) {
-    int threatScore = 0;
+// Every square the piece on (r, c) attacks, regardless of what stands there
+uint64_t Engine::pieceAttacks(int r, int c, Piece p) {
+    uint64_t attacks = 0;
+    switch (pieceType(p)) {
+    case PAWN: {
+        int dir = isWhitePiece(p) ? -1 : +1;
+        if (isInsideBoard(r + dir, c - 1)) attacks |= squareBit(r + dir, c - 1);
+        if (isInsideBoard(r + dir, c + 1)) attacks |= squareBit(r + dir, c + 1);
+        break;
+    }
+    case KNIGHT:
+        for (auto& s : KNIGHT_STEPS)
+            if (isInsideBoard(r + s[0], c + s[1])) attacks |= squareBit(r + s[0], c + s[1]);
+        break;
+    case KING:
+        for (auto& s : KING_STEPS)
+            if (isInsideBoard(r + s[0], c + s[1])) attacks |= squareBit(r + s[0], c + s[1]);
+        break;
+    case BISHOP: attacks = slidingAttacks(r, c, BISHOP_DIRS); break;
+    case ROOK: attacks = slidingAttacks(r, c, ROOK_DIRS); break;
+    case QUEEN: attacks = slidingAttacks(r, c, BISHOP_DIRS) | slidingAttacks(r, c, ROOK_DIRS); break;
+    }
+    return attacks;
+}
+
+// One side's attacks, built in a single pass over the board per evaluated position
+struct AttackMap {
+    uint64_t pieces;            // squares occupied by this side
+    uint64_t pawns;
+    uint64_t rooks;
+    int kingSq;                 // -1 if the king is missing
+    uint64_t all;               // squares attacked at least once
+    uint64_t twice;             // squares attacked at least twice
+    uint64_t bySquare[64];      // attacks of the piece standing on each square
+};
 
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            char p = boardLogic[r][c];
-            if (p == ' ') continue;
-            if ((isupper(p) != 0) != ourColor) continue;
+template<Side Us>
+void Engine::buildAttackMap(AttackMap& map) {
+    map.pieces = map.pawns = map.rooks = map.all = map.twice = 0;
+    map.kingSq = -1;
+    for (uint64_t b = pieceLists.occupied[Us]; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        Piece p = boardLogic[sq / 8][sq % 8];
+
+        uint64_t attacks = pieceAttacks(sq / 8, sq % 8, p);
+        map.bySquare[sq] = attacks;
+        map.pieces |= 1ULL << sq;
+        map.twice |= map.all & attacks;
+        map.all |= attacks;
+
+        switch (pieceType(p)) {
+        case PAWN: map.pawns |= 1ULL << sq; break;
+        case ROOK: map.rooks |= 1ULL << sq; break;
+        case KING: map.kingSq = sq; break;
+        }
+    }
+}
 
-            int attackers = countAttackers(r, c, !ourColor);
-            int defenders = countAttackers(r, c, ourColor);
+// ===================== COLOUR-SPECIALISED ATTACKS =====================
 
-            if (attackers > defenders) {
-                // Hanging piece - MASSIVE penalty
-                threatScore -= pieceValue(p) * 2;
-            }
-            else if (attackers > 0) {
-                // Attacked but defended - minor penalty
-                threatScore -= pieceValue(p) / 6;
-            }
+// Board geometry for one side, so direction and rank tests fold to constants
+template<Side Us>
+struct SideTraits {
+    static constexpr int PAWN_DIR = Us == WHITE ? -1 : +1;     // row step of a pawn push
+    static constexpr int PAWN_START_ROW = Us == WHITE ? 6 : 1;
+    static constexpr int HOME_ROW = Us == WHITE ? 7 : 0;
+};
+
+template<Side Them>
+bool Engine::squareAttackedBy(int r, int c) {
+    constexpr int pawnRow = -SideTraits<Them>::PAWN_DIR;   // their pawns attack from one row behind
+    constexpr Piece pawn = sidePiece<Them>(PAWN), knight = sidePiece<Them>(KNIGHT), king = sidePiece<Them>(KING);
+    constexpr Piece rook = sidePiece<Them>(ROOK), bishop = sidePiece<Them>(BISHOP), queen = sidePiece<Them>(QUEEN);
+
+    if (isInsideBoard(r + pawnRow, c - 1) && boardLogic[r + pawnRow][c - 1] == pawn) return true;
+    if (isInsideBoard(r + pawnRow, c + 1) && boardLogic[r + pawnRow][c + 1] == pawn) return true;
+
+    for (auto& s : KNIGHT_STEPS)
+        if (isInsideBoard(r + s[0], c + s[1]) && boardLogic[r + s[0]][c + s[1]] == knight) return true;
+    for (auto& s : KING_STEPS)
+        if (isInsideBoard(r + s[0], c + s[1]) && boardLogic[r + s[0]][c + s[1]] == king) return true;
+
+    for (auto& d : ROOK_DIRS) {
+        int x = r + d[0], y = c + d[1];
+        while (isInsideBoard(x, y) && boardLogic[x][y] == EMPTY) { x += d[0]; y += d[1]; }
+        if (isInsideBoard(x, y) && (boardLogic[x][y] == rook || boardLogic[x][y] == queen)) return true;
+    }
+    for (auto& d : BISHOP_DIRS) {
+        int x = r + d[0], y = c + d[1];
+        while (isInsideBoard(x, y) && boardLogic[x][y] == EMPTY) { x += d[0]; y += d[1]; }
+        if (isInsideBoard(x, y) && (boardLogic[x][y] == bishop || boardLogic[x][y] == queen)) return true;
+    }
+    return false;
+}
+
+template<Side Us>
+bool Engine::inCheck() {
+    int kingSq = pieceLists.kingSq[Us];
+    if (kingSq < 0) return false; // safety
+    return squareAttackedBy<opposite(Us)>(kingSq / 8, kingSq % 8);
+}
+
+// Destinations isValidMove would accept for a piece of the side to move; legality
+// (own king left in check) is still up to the caller
+template<Side Us>
+uint64_t Engine::pseudoTargets(int r, int c, Piece p) {
+    typedef SideTraits<Us> T;
+    constexpr Side Them = opposite(Us);
+    uint64_t own = pieceLists.occupied[Us];
+
+    switch (pieceType(p)) {
+    case PAWN: {
+        uint64_t targets = 0;
+        int x = r + T::PAWN_DIR;
+        if (x < 0 || x > 7) return 0;
+        if (boardLogic[x][c] == EMPTY) {
+            targets |= squareBit(x, c);
+            if (r == T::PAWN_START_ROW && boardLogic[x + T::PAWN_DIR][c] == EMPTY)
+                targets |= squareBit(x + T::PAWN_DIR, c);
+        }
+        for (int y = c - 1; y <= c + 1; y += 2) {
+            if (y < 0 || y > 7) continue;
+            if (pieceLists.occupied[Them] & squareBit(x, y)) targets |= squareBit(x, y);
+            else if (x == enPassantRow && y == enPassantCol && boardLogic[x][y] == EMPTY) targets |= squareBit(x, y);
+        }
+        return targets;
+    }
+    case KING: {
+        uint64_t targets = pieceAttacks(r, c, p) & ~own;
+        bool kingMoved = Us == WHITE ? whiteKingMoved : blackKingMoved;
+        if (r == T::HOME_ROW && c == 4 && !kingMoved && !squareAttackedBy<Them>(r, 4)) {
+            bool rightMoved = Us == WHITE ? whiteRookRightMoved : blackRookRightMoved;
+            bool leftMoved = Us == WHITE ? whiteRookLeftMoved : blackRookLeftMoved;
+            if (!rightMoved && boardLogic[r][5] == EMPTY && boardLogic[r][6] == EMPTY &&
+                !squareAttackedBy<Them>(r, 5) && !squareAttackedBy<Them>(r, 6))
+                targets |= squareBit(r, 6);
+            if (!leftMoved && boardLogic[r][1] == EMPTY && boardLogic[r][2] == EMPTY && boardLogic[r][3] == EMPTY &&
+                !squareAttackedBy<Them>(r, 3) && !squareAttackedBy<Them>(r, 2))
+                targets |= squareBit(r, 2);
         }
+        return targets;
+    }
+    default:
+        return pieceAttacks(r, c, p) & ~own;
+    }
+}
+
+// ===================== THREAT EVALUATION =====================
+
+int Engine::evaluateThreats(const AttackMap& ours, const AttackMap& theirs) {
+    int threatScore = 0;
+
+    uint64_t attacked = ours.pieces & theirs.all;
+    // More attackers than defenders: undefended, or hit twice and defended once
+    uint64_t hanging = attacked & (~ours.all | (theirs.twice & ~ours.twice));
+    uint64_t pressured = attacked & ~hanging;
+
+    for (uint64_t b = hanging; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        Piece p = boardLogic[sq / 8][sq % 8];
+        if (pieceType(p) == KING) continue; // checks are the search's business
+        threatScore -= pieceValue(p) * 2; // Hanging piece - MASSIVE penalty
+    }
+    for (uint64_t b = pressured; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        Piece p = boardLogic[sq / 8][sq % 8];
+        if (pieceType(p) == KING) continue;
+        threatScore -= pieceValue(p) / 6; // Attacked but defended - minor penalty
     }
 
     return threatScore;
 }
 
-// Detect fork opportunities
-int detectForks(bool ourColor) {
+// Detect fork opportunities: one piece attacking two or more enemy pieces
+int Engine::detectForks(const AttackMap& ours, const AttackMap& theirs) {
     int forkBonus = 0;
 
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            char p = boardLogic[r][c];
-            if (p == ' ' || (isupper(p) != 0) != ourColor) continue;
+    for (uint64_t b = ours.pieces; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        uint64_t targets = ours.bySquare[sq] & theirs.pieces;
+        if (popCount(targets) < 2) continue;
 
-            std::vector<int> targetValues;
+        int sum = 0;
+        for (uint64_t t = targets; t; t &= t - 1) {
+            int tsq = lowestSquare(t);
+            Piece target = boardLogic[tsq / 8][tsq % 8];
+            if (pieceType(target) != KING) sum += pieceValue(target); // a check counts as a prong, not as material
+        }
+        forkBonus += sum / 4;
+    }
 
-            for (int dr = 0; dr < 8; dr++) {
-                for (int dc = 0; dc < 8; dc++) {
-                    char target = boardLogic[dr][dc];
-                    if (target == ' ' || (isupper(target) != 0) == ourColor) continue;
+    return forkBonus;
+}
+
+// ===================== HASHING =====================
+
+const int WHITE_PAWN_INDEX = 0;
+const int BLACK_PAWN_INDEX = 6;
 
-                    if (isValidMove(r, c, dr, dc)) {
-                        targetValues.push_back(pieceValue(target));
+// Piece placement only; setSquare keeps it up to date
+uint64_t Engine::computePositionKey() {
+    return pieceLists.key;
+}
+
+// ===================== FUSED PIECE-SQUARE TABLES =====================
+
+// Material + placement for every [phase][piece slot][square], signed from White's
+// view and mirrored for Black, so evaluation adds one entry per piece
+struct alignas(32) FusedPST {
+    int16_t value[2][12][64];   // [0] middlegame, [1] endgame
+};
+constexpr FusedPST makeFusedPST() {
+    FusedPST t{};
+    const int values[6] = { 100, 500, 320, 330, 900, 20000 };   // P R N B Q K
+    for (int phase = 0; phase < 2; phase++) {
+        for (int type = 0; type < 6; type++) {
+            for (int sq = 0; sq < 64; sq++) {
+                int r = sq / 8, c = sq % 8;
+                for (int black = 0; black < 2; black++) {
+                    int row = black ? 7 - r : r;
+                    int positional = 0;
+                    switch (type) {
+                    case 0: positional = PAWN_TABLE[row][c]; break;
+                    case 1: positional = ROOK_TABLE[row][c]; break;
+                    case 2: positional = KNIGHT_TABLE[row][c]; break;
+                    case 3: positional = BISHOP_TABLE[row][c]; break;
+                    case 4: positional = QUEEN_TABLE[row][c]; break;
+                    case 5: positional = phase ? KING_END_TABLE[row][c] : KING_MIDDLE_TABLE[row][c]; break;
                     }
+                    int total = values[type] + positional;
+                    t.value[phase][type + black * 6][sq] = (int16_t)(black ? -total : total);
                 }
             }
+        }
+    }
+    return t;
+}
+constexpr FusedPST FUSED_PST = makeFusedPST();
 
-            if (targetValues.size() >= 2) {
-                int sum = 0;
-                for (int val : targetValues) sum += val;
-                forkBonus += sum / 4;
-            }
+// ===================== SIMD BOARD SUMMATION =====================
+
+// Centipawns per square a piece can move to or capture on, by slot (P R N B Q K), White's sign
+const int16_t MOBILITY_WEIGHT[12] = { 0, 2, 4, 5, 1, 0, 0, -2, -4, -5, -1, 0 };
+const Piece SLOT_PIECES[12] = { W_PAWN, W_ROOK, W_KNIGHT, W_BISHOP, W_QUEEN, W_KING,
+                                B_PAWN, B_ROOK, B_KNIGHT, B_BISHOP, B_QUEEN, B_KING };
+
+// Sum of fused table entries plus weighted mobility over the 64-byte board
+int sumBoardScalar(const Piece* board, const int16_t (*pst)[64], const uint8_t* mobility) {
+    int score = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        int idx = pieceIndex(board[sq]);
+        if (idx < 0) continue;
+        score += pst[idx][sq] + MOBILITY_WEIGHT[idx] * mobility[sq];
+    }
+    return score;
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAVE_X86_SIMD
+#endif
+
+#ifdef HAVE_X86_SIMD
+#if defined(__GNUC__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+// Every square holds at most one piece, so per-square values are gathered with
+// compare masks and OR'd together, then widened to 32 bits once at the end
+AVX2_TARGET int sumBoardAvx2(const Piece* board, const int16_t (*pst)[64], const uint8_t* mobility) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(board));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(board + 32));
+
+    __m256i values[4], weights[4];
+    for (int k = 0; k < 4; k++) values[k] = weights[k] = _mm256_setzero_si256();
+
+    for (int idx = 0; idx < 12; idx++) {
+        __m256i code = _mm256_set1_epi8(SLOT_PIECES[idx]);
+        __m256i mlo = _mm256_cmpeq_epi8(lo, code);
+        __m256i mhi = _mm256_cmpeq_epi8(hi, code);
+        if (_mm256_testz_si256(_mm256_or_si256(mlo, mhi), _mm256_set1_epi8(-1))) continue;
+
+        __m256i masks[4] = {
+            _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mlo)),
+            _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mlo, 1)),
+            _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mhi)),
+            _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mhi, 1))
+        };
+        __m256i mobWeight = _mm256_set1_epi16(MOBILITY_WEIGHT[idx]);
+        for (int k = 0; k < 4; k++) {
+            __m256i table = _mm256_load_si256(reinterpret_cast<const __m256i*>(&pst[idx][k * 16]));
+            values[k] = _mm256_or_si256(values[k], _mm256_and_si256(masks[k], table));
+            weights[k] = _mm256_or_si256(weights[k], _mm256_and_si256(masks[k], mobWeight));
         }
     }
 
-    return forkBonus;
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = 0; k < 4; k++) {
+        __m128i mobBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mobility + k * 16));
+        __m256i mob = _mm256_cvtepu8_epi16(mobBytes);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values[k], ones));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(weights[k], mob));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    if (!osSavesYmm) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef int (*BoardSumKernel)(const Piece*, const int16_t (*)[64], const uint8_t*);
+
+BoardSumKernel selectBoardSumKernel() {
+#ifdef HAVE_X86_SIMD
+    if (cpuHasAvx2()) return sumBoardAvx2;
+#endif
+    return sumBoardScalar;
+}
+const BoardSumKernel sumBoard = selectBoardSumKernel();
+
+// ===================== PAWN STRUCTURE =====================
+
+const uint64_t FILE_A_MASK = 0x0101010101010101ULL;
+
+// Indexed by the pawn's rank from its owner's side, less one: 1 = home rank, 6 = seventh rank
+const int PASSED_PAWN_BONUS[8] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+const int ISOLATED_PAWN_PENALTY = 15;
+const int DOUBLED_PAWN_PENALTY = 12;
+const int SHIELD_PAWN_BONUS = 10;
+const int OPEN_FILE_ROOK_BONUS = 50;
+const int HALF_OPEN_FILE_ROOK_BONUS = 25;
+
+// Everything here depends on pawn placement only, so it is cached by pawn key
+struct PawnEntry {
+    uint64_t key;
+    int score;                  // passed/isolated/doubled terms, White's view
+    uint8_t openFiles;          // bit f set: no pawns at all on file f
+    uint8_t halfOpenFiles[2];   // bit f set: no pawns of that side on file f
+    int8_t shield[2][8];        // own pawns in front of a king castled on that file
+};
+
+const int PAWN_HASH_SIZE = 1 << 13;
+
+uint64_t fileMask(int c) {
+    return FILE_A_MASK << c;
+}
+uint64_t rowsAbove(int r) {     // rows 0 .. r-1
+    return r == 0 ? 0 : (~0ULL >> (64 - r * 8));
+}
+uint64_t rowsBelow(int r) {     // rows r+1 .. 7
+    return r == 7 ? 0 : (~0ULL << ((r + 1) * 8));
+}
+
+template<Side Us>
+void addPawnTerms(uint64_t own, uint64_t enemy, PawnEntry& e) {
+    constexpr int sign = Us == WHITE ? 1 : -1;
+
+    for (uint64_t b = own; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        int r = sq / 8, c = sq % 8;
+
+        uint64_t adjacent = (c > 0 ? fileMask(c - 1) : 0) | (c < 7 ? fileMask(c + 1) : 0);
+        if ((own & adjacent) == 0) e.score -= sign * ISOLATED_PAWN_PENALTY;
+
+        uint64_t ahead = Us == WHITE ? rowsAbove(r) : rowsBelow(r);
+        if ((enemy & (adjacent | fileMask(c)) & ahead) == 0) {
+            int advanced = Us == WHITE ? 7 - r : r;
+            e.score += sign * PASSED_PAWN_BONUS[advanced];
+        }
+    }
+
+    // Shield: own pawns on the king's file and its neighbours, one or two rows in front of home
+    constexpr uint64_t shieldRows = Us == WHITE ? (0xFFULL << 48 | 0xFFULL << 40) : (0xFFULL << 8 | 0xFFULL << 16);
+    for (int c = 0; c < 8; c++) {
+        uint64_t files = fileMask(c) | (c > 0 ? fileMask(c - 1) : 0) | (c < 7 ? fileMask(c + 1) : 0);
+        e.shield[Us][c] = (int8_t)popCount(own & files & shieldRows);
+    }
+}
+
+void computePawnEntry(uint64_t whitePawns, uint64_t blackPawns, PawnEntry& e) {
+    e.score = 0;
+    e.openFiles = 0;
+    e.halfOpenFiles[0] = e.halfOpenFiles[1] = 0;
+
+    for (int c = 0; c < 8; c++) {
+        int whiteCount = popCount(whitePawns & fileMask(c));
+        int blackCount = popCount(blackPawns & fileMask(c));
+        if (whiteCount == 0) e.halfOpenFiles[0] |= 1 << c;
+        if (blackCount == 0) e.halfOpenFiles[1] |= 1 << c;
+        if (whiteCount == 0 && blackCount == 0) e.openFiles |= 1 << c;
+
+        if (whiteCount > 1) e.score -= DOUBLED_PAWN_PENALTY * (whiteCount - 1);
+        if (blackCount > 1) e.score += DOUBLED_PAWN_PENALTY * (blackCount - 1);
+    }
+
+    addPawnTerms<WHITE>(whitePawns, blackPawns, e);
+    addPawnTerms<BLACK>(blackPawns, whitePawns, e);
+}
+
+const PawnEntry& Engine::probePawnHash(uint64_t key, uint64_t whitePawns, uint64_t blackPawns) {
+    PawnEntry& e = pawnHash[key & (PAWN_HASH_SIZE - 1)];
+    if (e.key != key) {
+        computePawnEntry(whitePawns, blackPawns, e);
+        e.key = key;
+    }
+    return e;
 }
 
 // ===================== EVALUATION =====================
 
-int evaluateBoard(bool aiIsWhite) {
+// Rook files, king shelter, threats and forks for one side, signed from that side's view
+template<Side Us>
+int Engine::sideTerms(const AttackMap& ours, const AttackMap& theirs, const PawnEntry& pawns, bool endgame) {
     int score = 0;
-    bool endgame = isEndgamePhase();
 
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            char p = boardLogic[r][c];
-            if (p == ' ') continue;
-
-            bool isWhite = (isupper(p) != 0);
-            int val = pieceValue(p);
-            int positional = 0;
-            char type = tolower(p);
-
-            int tableRow = isWhite ? r : (7 - r);
-
-            switch (type) {
-            case 'p': positional = PAWN_TABLE[tableRow][c]; break;
-            case 'n': positional = KNIGHT_TABLE[tableRow][c]; break;
-            case 'b': positional = BISHOP_TABLE[tableRow][c]; break;
-            case 'r':
-                positional = ROOK_TABLE[tableRow][c];
-                if (isOpenFile(c)) positional += 50;
-                break;
-            case 'q': positional = QUEEN_TABLE[tableRow][c]; break;
-            case 'k': positional = endgame ? KING_END_TABLE[tableRow][c] : KING_MIDDLE_TABLE[tableRow][c]; break;
-            }
+    for (uint64_t b = ours.rooks; b; b &= b - 1) {
+        int c = lowestSquare(b) % 8;
+        if (pawns.openFiles & (1 << c)) score += OPEN_FILE_ROOK_BONUS;
+        else if (pawns.halfOpenFiles[Us] & (1 << c)) score += HALF_OPEN_FILE_ROOK_BONUS;
+    }
 
-            int total = val + positional;
-            score += isWhite ? total : -total;
-        }
+    // A castled king wants its pawns in front of it; irrelevant once the queens are gone
+    if (!endgame) {
+        bool onBackRanks = Us == WHITE ? ours.kingSq >= 48 : (ours.kingSq >= 0 && ours.kingSq < 16);
+        if (onBackRanks) score += SHIELD_PAWN_BONUS * pawns.shield[Us][ours.kingSq % 8];
     }
 
     // CRITICAL: Heavy weight on threats
-    score += evaluateThreats(true) * 3;
-    score -= evaluateThreats(false) * 3;
+    score += evaluateThreats(ours, theirs) * 3;
+    score += detectForks(ours, theirs);
+
+    return score;
+}
+
+// Full static evaluation from White's point of view
+int Engine::evaluateBoardFull() {
+    bool endgame = isEndgamePhase();
+
+    AttackMap whiteMap, blackMap;
+    buildAttackMap<WHITE>(whiteMap);
+    buildAttackMap<BLACK>(blackMap);
+
+    // Squares each piece can move to or capture on
+    alignas(32) uint8_t mobility[64] = {};
+    for (uint64_t b = whiteMap.pieces; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        mobility[sq] = (uint8_t)popCount(whiteMap.bySquare[sq] & ~whiteMap.pieces);
+    }
+    for (uint64_t b = blackMap.pieces; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        mobility[sq] = (uint8_t)popCount(blackMap.bySquare[sq] & ~blackMap.pieces);
+    }
+
+    int score = sumBoard(&boardLogic[0][0], FUSED_PST.value[endgame ? 1 : 0], mobility);
+
+    uint64_t pawnKey = ZOBRIST.pawnSeed;
+    for (uint64_t b = whiteMap.pawns; b; b &= b - 1) pawnKey ^= ZOBRIST.piece[WHITE_PAWN_INDEX][lowestSquare(b)];
+    for (uint64_t b = blackMap.pawns; b; b &= b - 1) pawnKey ^= ZOBRIST.piece[BLACK_PAWN_INDEX][lowestSquare(b)];
+
+    const PawnEntry& pawns = probePawnHash(pawnKey, whiteMap.pawns, blackMap.pawns);
+    score += pawns.score;
+
+    score += sideTerms<WHITE>(whiteMap, blackMap, pawns, endgame);
+    score -= sideTerms<BLACK>(blackMap, whiteMap, pawns, endgame);
+
+    return score;
+}
 
-    score += detectForks(true);
-    score -= detectForks(false);
+// Always-replace cache of static scores; the score depends on piece placement only
+struct EvalCacheEntry {
+    uint64_t key;
+    int score;      // White's view
+};
+
+const int EVAL_CACHE_SIZE = 1 << 16;
+
+Engine::Engine() : pawnHash(PAWN_HASH_SIZE), evalCache(EVAL_CACHE_SIZE) {}
+
+// The game on screen; the puzzle screen and the AI play on it too
+Engine game;
 
-    return aiIsWhite ? score : -score;
+const char* NNUE_WEIGHTS_FILE = "nnue/chess.nnue";
+const char* PUZZLE_CSV_FILE = "puzzles/lichess_db_puzzle.csv";
+const char* PUZZLE_PACK_FILE = "puzzles/puzzles.pack";
+
+template<Side Us>
+int Engine::evaluateFor() {
+    uint64_t key = computePositionKey();
+    EvalCacheEntry& e = evalCache[key & (EVAL_CACHE_SIZE - 1)];
+    if (e.key != key) {
+        e.key = key;
+        e.score = nnue.isLoaded() ? nnue.evaluate() : evaluateBoardFull();
+    }
+    return Us == WHITE ? e.score : -e.score;
+}
+int Engine::evaluateBoard(bool aiIsWhite) {
+    return aiIsWhite ? evaluateFor<WHITE>() : evaluateFor<BLACK>();
 }
 
 // ===================== MOVE GENERATION =====================
 
-void simulateMove(Move m, char board[8][8]) {
-    char p = board[m.sx][m.sy];
-    board[m.dx][m.dy] = p;
-    board[m.sx][m.sy] = ' ';
+void Engine::simulateMove(const Move& m) {
+    Piece p = boardLogic[m.sx][m.sy];
+    setSquare(m.dx, m.dy, p);
+    setSquare(m.sx, m.sy, EMPTY);
 
-    if ((p == 'P' && m.dx == 0) || (p == 'p' && m.dx == 7)) {
-        board[m.dx][m.dy] = (isupper(p) != 0) ? 'Q' : 'q';
+    if ((p == W_PAWN && m.dx == 0) || (p == B_PAWN && m.dx == 7)) {
+        setSquare(m.dx, m.dy, makePiece(m.promotion, isWhitePiece(p)));
     }
 }
 
-std::vector<Move> generateAllMoves(bool whiteTurn) {
-    std::vector<Move> moves;
+// Search make/unmake: the move is played by playMove, so castling rights, the en passant
+// square and the position history follow the line, and taken back from its record. The
+// NNUE accumulator is updated incrementally from the squares the move changed.
+struct SearchUndo {
+    Piece board[8][8];      // before the move, for the NNUE update
+    MoveRecord record;
+};
 
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            char p = boardLogic[r][c];
-            if (p == ' ' || (isupper(p) != 0) != whiteTurn) continue;
+void Engine::makeSearchMove(const Move& m, SearchUndo& undo) {
+    if (nnue.isLoaded()) copyBoard(boardLogic, undo.board);
+    undo.record = playMove(m.sx, m.sy, m.dx, m.dy);
+    if ((undo.record.moved == W_PAWN && m.dx == 0) || (undo.record.moved == B_PAWN && m.dx == 7))
+        setSquare(m.dx, m.dy, makePiece(m.promotion, isWhitePiece(undo.record.moved)));
+    if (nnue.isLoaded()) nnue.push(undo.board, boardLogic);
+}
 
-            for (int dr = 0; dr < 8; dr++) {
-                for (int dc = 0; dc < 8; dc++) {
-                    if (!isValidMove(r, c, dr, dc)) continue;
+void Engine::unmakeSearchMove(const SearchUndo& undo) {
+    unplayMove(undo.record);
+    if (nnue.isLoaded()) nnue.pop();
+}
 
-                    char captured = boardLogic[dr][dc];
-                    char moved = boardLogic[r][c];
+template<Side Us>
+std::vector<Move> Engine::generateMoves() {
+    std::vector<Move> moves;
 
-                    boardLogic[dr][dc] = moved;
-                    boardLogic[r][c] = ' ';
+    for (uint64_t pieces = pieceLists.occupied[Us]; pieces; pieces &= pieces - 1) {
+        int from = lowestSquare(pieces);
+        int r = from / 8, c = from % 8;
 
-                    bool kingInCheck = isInCheck(whiteTurn);
+        for (uint64_t targets = pseudoTargets<Us>(r, c, boardLogic[r][c]); targets; targets &= targets - 1) {
+            int to = lowestSquare(targets);
+            int dr = to / 8, dc = to % 8;
 
-                    boardLogic[r][c] = moved;
-                    boardLogic[dr][dc] = captured;
+            TrialMove trial = playTrialMove(r, c, dr, dc);
+            bool kingInCheck = inCheck<Us>();
+            undoTrialMove(trial);
 
-                    if (!kingInCheck) {
-                        moves.push_back({ r, c, dr, dc });
-                    }
-                }
+            if (!kingInCheck) {
+                moves.push_back({ r, c, dr, dc });
             }
         }
     }
@@ -1426,12 +2133,35 @@ std::vector<Move> generateAllMoves(bool whiteTurn) {
     return moves;
 }
 
+template<Side Us>
+bool Engine::hasLegalMove() {
+    for (uint64_t pieces = pieceLists.occupied[Us]; pieces; pieces &= pieces - 1) {
+        int from = lowestSquare(pieces);
+        int r = from / 8, c = from % 8;
+
+        for (uint64_t targets = pseudoTargets<Us>(r, c, boardLogic[r][c]); targets; targets &= targets - 1) {
+            int to = lowestSquare(targets);
+
+            TrialMove trial = playTrialMove(r, c, to / 8, to % 8); //Temporary move to Destination for Check still in check or Not
+            bool stillCheck = inCheck<Us>();
+            undoTrialMove(trial);
+
+            if (!stillCheck) return true;
+        }
+    }
+    return false;
+}
+
+std::vector<Move> Engine::generateAllMoves(bool turn) {
+    return turn ? generateMoves<WHITE>() : generateMoves<BLACK>();
+}
+
 // ===================== MOVE ORDERING =====================
 
-int scoreMoveForOrdering(const Move& m, bool isWhite) {
+int Engine::scoreMoveForOrdering(const Move& m, bool isWhite) {
     int score = 0;
-    char attacker = boardLogic[m.sx][m.sy];
-    char victim = boardLogic[m.dx][m.dy];
+    Piece attacker = boardLogic[m.sx][m.sy];
+    Piece victim = boardLogic[m.dx][m.dy];
 
     // CRITICAL: Reject unsafe moves
     if (!isMoveTrulySafe(m.sx, m.sy, m.dx, m.dy)) {
@@ -1439,7 +2169,7 @@ int scoreMoveForOrdering(const Move& m, bool isWhite) {
     }
 
     // Captures
-    if (victim != ' ') {
+    if (victim != EMPTY) {
         int see = fullStaticExchange(m.sx, m.sy, m.dx, m.dy);
         if (see > 0) {
             score += 50000 + see * 10; // Great capture
@@ -1453,18 +2183,20 @@ int scoreMoveForOrdering(const Move& m, bool isWhite) {
     }
 
     // Promotions
-    if (tolower(attacker) == 'p' && (m.dx == 0 || m.dx == 7)) {
+    if (pieceType(attacker) == PAWN && (m.dx == 0 || m.dx == 7)) {
         score += 90000;
     }
 
     // Checks
-    char backup[8][8];
+    Piece backup[8][8];
     copyBoard(boardLogic, backup);
-    simulateMove(m, boardLogic);
+    PieceLists backupLists = pieceLists;
+    simulateMove(m);
     if (isInCheck(!isWhite)) {
         score += 1000;
     }
     copyBoard(backup, boardLogic);
+    pieceLists = backupLists;
 
     // Center control
     if (m.dx >= 3 && m.dx <= 4 && m.dy >= 3 && m.dy <= 4) {
@@ -1476,7 +2208,14 @@ int scoreMoveForOrdering(const Move& m, bool isWhite) {
 
 // ===================== QUIESCENCE =====================
 
-int quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth = 0) {
+bool Engine::searchOutOfTime() {
+    if (searchDeadline != std::chrono::steady_clock::time_point::max() && (++searchNodes & 15) == 0
+        && std::chrono::steady_clock::now() > searchDeadline) searchAborted = true;
+    return searchAborted;
+}
+
+int Engine::quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth) {
+    if (searchOutOfTime()) return 0;
     if (depth > 3) return evaluateBoard(aiIsWhite);
 
     int standPat = evaluateBoard(aiIsWhite);
@@ -1494,7 +2233,7 @@ int quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth =
     std::vector<Move> captures;
 
     for (auto& m : allMoves) {
-        if (boardLogic[m.dx][m.dy] != ' ') {
+        if (boardLogic[m.dx][m.dy] != EMPTY) {
             if (fullStaticExchange(m.sx, m.sy, m.dx, m.dy) >= 0) {
                 captures.push_back(m);
             }
@@ -1507,13 +2246,12 @@ int quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth =
         });
 
     for (auto& m : captures) {
-        char backup[8][8];
-        copyBoard(boardLogic, backup);
-        simulateMove(m, boardLogic);
+        SearchUndo undo;
+        makeSearchMove(m, undo);
 
         int score = quiescence(alpha, beta, !maximizing, aiIsWhite, depth + 1);
 
-        copyBoard(backup, boardLogic);
+        unmakeSearchMove(undo);
 
         if (maximizing) {
             if (score >= beta) return beta;
@@ -1532,9 +2270,14 @@ int quiescence(int alpha, int beta, bool maximizing, bool aiIsWhite, int depth =
 
 const int MATE_SCORE = 30000;
 
-int minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite) {
+int Engine::minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite) {
+    if (searchOutOfTime()) return 0;
+
     bool currentTurn = maximizing ? aiIsWhite : !aiIsWhite;
 
+    // Any repetition inside the line is scored as the draw it can be forced into
+    if (halfmoveClock >= 100 || repetitionCount(gameKey(currentTurn)) > 0) return 0;
+
     if (isCheckmate(currentTurn)) {
         return maximizing ? (-MATE_SCORE + depth) : (MATE_SCORE - depth);
     }
@@ -1552,13 +2295,12 @@ int minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite) {
     if (maximizing) {
         int maxEval = -999999;
         for (auto& m : moves) {
-            char backup[8][8];
-            copyBoard(boardLogic, backup);
-            simulateMove(m, boardLogic);
+            SearchUndo undo;
+            makeSearchMove(m, undo);
 
             int eval = minimax(depth - 1, false, alpha, beta, aiIsWhite);
 
-            copyBoard(backup, boardLogic);
+            unmakeSearchMove(undo);
 
             maxEval = std::max(maxEval, eval);
             alpha = std::max(alpha, eval);
@@ -1569,13 +2311,12 @@ int minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite) {
     else {
         int minEval = 999999;
         for (auto& m : moves) {
-            char backup[8][8];
-            copyBoard(boardLogic, backup);
-            simulateMove(m, boardLogic);
+            SearchUndo undo;
+            makeSearchMove(m, undo);
 
             int eval = minimax(depth - 1, true, alpha, beta, aiIsWhite);
 
-            copyBoard(backup, boardLogic);
+            unmakeSearchMove(undo);
 
             minEval = std::min(minEval, eval);
             beta = std::min(beta, eval);
@@ -1587,7 +2328,7 @@ int minimax(int depth, bool maximizing, int alpha, int beta, bool aiIsWhite) {
 
 // ===================== FIND BEST MOVE =====================
 
-Move findBestAIMove(AILevel level, bool aiIsWhite) {
+Move Engine::findBestAIMove(AILevel level, bool aiIsWhite) {
     std::vector<Move> moves = generateAllMoves(aiIsWhite);
     if (moves.empty()) return { -1, -1, -1, -1 };
 
@@ -1617,14 +2358,15 @@ Move findBestAIMove(AILevel level, bool aiIsWhite) {
         return scoreMoveForOrdering(a, aiIsWhite) > scoreMoveForOrdering(b, aiIsWhite);
         });
 
+    if (nnue.isLoaded()) nnue.refresh(boardLogic);
+
     for (auto& m : safeMoves) {
-        char backup[8][8];
-        copyBoard(boardLogic, backup);
-        simulateMove(m, boardLogic);
+        SearchUndo undo;
+        makeSearchMove(m, undo);
 
         int score = minimax(maxDepth - 1, false, -999999, 999999, aiIsWhite);
 
-        copyBoard(backup, boardLogic);
+        unmakeSearchMove(undo);
 
         if (score > bestScore) {
             bestScore = score;
@@ -1639,7 +2381,7 @@ Move findBestAIMove(AILevel level, bool aiIsWhite) {
 
 // ===================== APPLY AI MOVE =====================
 
-void applyAIMove(bool aiIsWhite) {
+void Engine::applyAIMove(bool aiIsWhite) {
     Move aiMove = findBestAIMove(aiDifficulty, aiIsWhite);
 
     if (aiMove.sx == -1) {
@@ -1647,15 +2389,12 @@ void applyAIMove(bool aiIsWhite) {
         return;
     }
 
-    recordStateBeforeMove();
     makeMove(aiMove.sx, aiMove.sy, aiMove.dx, aiMove.dy);
 
-    char movedPiece = boardLogic[aiMove.dx][aiMove.dy];
-    if ((movedPiece == 'P' && aiMove.dx == 0) || (movedPiece == 'p' && aiMove.dx == 7)) {
-        boardLogic[aiMove.dx][aiMove.dy] = (isupper(movedPiece) != 0) ? 'Q' : 'q';
+    Piece movedPiece = boardLogic[aiMove.dx][aiMove.dy];
+    if ((movedPiece == W_PAWN && aiMove.dx == 0) || (movedPiece == B_PAWN && aiMove.dx == 7)) {
+        promoteLastMove(makePiece(aiMove.promotion, isWhitePiece(movedPiece)));
     }
-
-    updateboard();
 }
 
 // =======================
@@ -2265,65 +3004,504 @@ void drawBoardLabels(sf::RenderWindow& window, sf::Font& font, float tileSize, f
 
 
 
-void loadBoardFromFEN(const string& fen) {
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            boardLogic[i][j] = ' ';
-            boardArr[i][j] = 0;
-        }
+// Sets up the full game state from a FEN; an invalid FEN leaves the game untouched
+bool Engine::loadBoardFromFEN(std::string_view fen) {
+    FenPosition pos;
+    if (const char* error = parseFen(fen, pos)) {
+        cout << "Invalid FEN (" << error << "): " << fen << endl;
+        return false;
     }
 
-    int row = 0, col = 0;
+    memcpy(boardLogic, pos.board, sizeof(boardLogic));
+    rebuildPieceLists();
+    clearPositionHistory();
+    clearMoveLog();
+    whiteCapCount = blackCapCount = 0;
+
+    whiteTurn = pos.whiteToMove;
+    whiteKingMoved = !(pos.castling & (CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN));
+    whiteRookRightMoved = !(pos.castling & CASTLE_WHITE_KING);
+    whiteRookLeftMoved = !(pos.castling & CASTLE_WHITE_QUEEN);
+    blackKingMoved = !(pos.castling & (CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN));
+    blackRookRightMoved = !(pos.castling & CASTLE_BLACK_KING);
+    blackRookLeftMoved = !(pos.castling & CASTLE_BLACK_QUEEN);
+    enPassantRow = pos.epRow;
+    enPassantCol = pos.epCol;
+    halfmoveClock = pos.halfmoveClock;
+
+    startFullmove = pos.fullmoveNumber;
+    startWhiteToMove = pos.whiteToMove;
+    return true;
+}
 
-    for (size_t idx = 0; idx < fen.length(); idx++) {
-        char c = fen[idx];
-        if (c == ' ') break;
+// The game state as a FenPosition; a castling right needs the king and rook still at home
+FenPosition Engine::currentFenPosition() {
+    FenPosition pos;
+    memcpy(pos.board, boardLogic, sizeof(boardLogic));
+    pos.whiteToMove = whiteTurn;
 
-        if (c == '/') {
-            row++;
-            col = 0;
-        }
-        else if (isdigit(c)) {
-            col += (c - '0');
+    pos.castling = 0;
+    if (!whiteKingMoved && boardLogic[7][4] == W_KING) {
+        if (!whiteRookRightMoved && boardLogic[7][7] == W_ROOK) pos.castling |= CASTLE_WHITE_KING;
+        if (!whiteRookLeftMoved && boardLogic[7][0] == W_ROOK) pos.castling |= CASTLE_WHITE_QUEEN;
+    }
+    if (!blackKingMoved && boardLogic[0][4] == B_KING) {
+        if (!blackRookRightMoved && boardLogic[0][7] == B_ROOK) pos.castling |= CASTLE_BLACK_KING;
+        if (!blackRookLeftMoved && boardLogic[0][0] == B_ROOK) pos.castling |= CASTLE_BLACK_QUEEN;
+    }
+
+    pos.epRow = (int8_t)enPassantRow;
+    pos.epCol = (int8_t)enPassantCol;
+    pos.halfmoveClock = halfmoveClock;
+    pos.fullmoveNumber = startFullmove + (plyCursor + (startWhiteToMove ? 0 : 1)) / 2;
+    return pos;
+}
+string Engine::boardToFEN() {
+    return toFen(currentFenPosition());
+}
+// ===================== SAN =====================
+
+const int SAN_MAX_LENGTH = 10;     // "Qa1xb2=Q#" plus terminator is the worst case
+
+// Squares of pieces equal to 'piece' that can legally move to (toR, toC); one pass over
+// the side's piece list, so disambiguation and decoding share the same legality rules
+template<Side Us>
+uint64_t Engine::legalOriginsTo(Piece piece, int toR, int toC) {
+    uint64_t origins = 0;
+    for (uint64_t pieces = pieceLists.occupied[Us]; pieces; pieces &= pieces - 1) {
+        int from = lowestSquare(pieces);
+        int r = from / 8, c = from % 8;
+        if (boardLogic[r][c] != piece) continue;
+        if (!(pseudoTargets<Us>(r, c, piece) & squareBit(toR, toC))) continue;
+
+        TrialMove trial = playTrialMove(r, c, toR, toC);
+        bool illegal = inCheck<Us>();
+        undoTrialMove(trial);
+
+        if (!illegal) origins |= squareBit(r, c);
+    }
+    return origins;
+}
+uint64_t Engine::legalOrigins(Piece piece, int toR, int toC) {
+    return isWhitePiece(piece) ? legalOriginsTo<WHITE>(piece, toR, toC) : legalOriginsTo<BLACK>(piece, toR, toC);
+}
+
+// Writes the SAN of a legal move in the current position into 'out' (SAN_MAX_LENGTH
+// bytes) and returns its length. 'promotion' is the piece a pawn on the last rank
+// becomes, a queen if left EMPTY.
+int Engine::writeSAN(int fromR, int fromC, int toR, int toC, Piece promotion, char* out) {
+    Piece piece = boardLogic[fromR][fromC];
+    bool white = isWhitePiece(piece);
+    char* p = out;
+
+    if (pieceType(piece) == KING && abs(toC - fromC) == 2) {
+        memcpy(p, toC == 6 ? "O-O" : "O-O-O", toC == 6 ? 3 : 5);
+        p += toC == 6 ? 3 : 5;
+    }
+    else {
+        bool isPawn = pieceType(piece) == PAWN;
+        bool isCapture = boardLogic[toR][toC] != EMPTY || (isPawn && fromC != toC);
+
+        if (isPawn) {
+            if (isCapture) *p++ = char('a' + fromC);
         }
         else {
-            boardLogic[row][col] = c;
-
-            switch (tolower(c)) {
-            case 'p': boardArr[row][col] = isupper(c) ? 1 : -1; break;
-            case 'r': boardArr[row][col] = isupper(c) ? 2 : -2; break;
-            case 'n': boardArr[row][col] = isupper(c) ? 3 : -3; break;
-            case 'b': boardArr[row][col] = isupper(c) ? 4 : -4; break;
-            case 'q': boardArr[row][col] = isupper(c) ? 5 : -5; break;
-            case 'k': boardArr[row][col] = isupper(c) ? 6 : -6; break;
+            *p++ = pieceToChar(makePiece(pieceType(piece), true));
+
+            // Another piece of the same kind reaching the square: file if that tells
+            // them apart, else rank, else both
+            uint64_t others = legalOrigins(piece, toR, toC) & ~squareBit(fromR, fromC);
+            if (others) {
+                uint64_t sameFile = 0, sameRank = 0;
+                for (uint64_t b = others; b; b &= b - 1) {
+                    int sq = lowestSquare(b);
+                    if (sq % 8 == fromC) sameFile |= 1;
+                    if (sq / 8 == fromR) sameRank |= 1;
+                }
+                if (!sameFile) *p++ = char('a' + fromC);
+                else if (!sameRank) *p++ = char('8' - fromR);
+                else { *p++ = char('a' + fromC); *p++ = char('8' - fromR); }
             }
-            col++;
+        }
+
+        if (isCapture) *p++ = 'x';
+        *p++ = char('a' + toC);
+        *p++ = char('8' - toR);
+
+        if (isPawn && (toR == 0 || toR == 7)) {
+            promotion = makePiece(promotion == EMPTY ? QUEEN : pieceType(promotion), white);
+            *p++ = '=';
+            *p++ = pieceToChar(makePiece(pieceType(promotion), true));
         }
     }
 
-    updateboard();
+    // Check or mate: play the move for real and look at the opponent
+    MoveRecord m = playMove(fromR, fromC, toR, toC);
+    if (pieceType(piece) == PAWN && (toR == 0 || toR == 7)) setSquare(toR, toC, promotion);
+    bool check = isInCheck(!white);
+    bool mate = check && !hasAnyLegalMove(!white);
+    unplayMove(m);
+
+    if (mate) *p++ = '#';
+    else if (check) *p++ = '+';
+    *p = '\0';
+    return (int)(p - out);
+}
+string Engine::moveToSAN(int fromR, int fromC, int toR, int toC, Piece promotion) {
+    char buf[SAN_MAX_LENGTH];
+    int len = writeSAN(fromR, fromC, toR, toC, promotion, buf);
+    return string(buf, len);
 }
-string moveToSAN(int fromR, int fromC, int toR, int toC) {
-    char piece = boardLogic[fromR][fromC];
-    string san = "";
 
-    if (toupper(piece) != 'P') {
-        san += toupper(piece);
+// Reads a SAN move for the side to move and finds it among the legal moves. Fails on
+// malformed text and on moves that are illegal or ambiguous. Check, mate and
+// annotation marks are optional and not verified; castling may use 'O' or '0'.
+bool Engine::parseSAN(std::string_view san, Move& move, Piece& promotion) {
+    bool white = whiteTurn;
+    int homeRow = white ? 7 : 0;
+    promotion = EMPTY;
+
+    while (!san.empty() && strchr("+#!? \t\r\n", san.back())) san.remove_suffix(1);
+    if (san.size() < 2) return false;
+
+    // ---------- Castling ----------
+    if (san[0] == 'O' || san[0] == '0') {
+        int toC;
+        if (san == "O-O" || san == "0-0") toC = 6;
+        else if (san == "O-O-O" || san == "0-0-0") toC = 2;
+        else return false;
+        Piece king = makePiece(KING, white);
+        if (!(legalOrigins(king, homeRow, toC) & squareBit(homeRow, 4))) return false;
+        move = Move(homeRow, 4, homeRow, toC);
+        return true;
+    }
+
+    // ---------- Promotion suffix ----------
+    int type = PAWN;
+    size_t end = san.size();
+    if (strchr("QRBN", san[end - 1])) {
+        promotion = makePiece(pieceType(pieceFromChar(san[end - 1])), white);
+        end--;
+        if (end > 0 && san[end - 1] == '=') end--;
+    }
+
+    // ---------- Destination ----------
+    if (end < 2) return false;
+    char file = san[end - 2], rank = san[end - 1];
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') return false;
+    int toR = '8' - rank, toC = file - 'a';
+    end -= 2;
+
+    // ---------- Piece letter, disambiguation, capture mark ----------
+    size_t i = 0;
+    if (i < end && strchr("KQRBN", san[i])) type = pieceType(pieceFromChar(san[i++]));
+    int fromC = -1, fromR = -1;
+    if (i < end && san[i] >= 'a' && san[i] <= 'h') fromC = san[i++] - 'a';
+    if (i < end && san[i] >= '1' && san[i] <= '8') fromR = '8' - san[i++];
+    bool capture = i < end && (san[i] == 'x' || san[i] == ':');
+    if (capture) i++;
+    if (i != end) return false;
+    if (type == PAWN && !capture && fromC < 0) fromC = toC;    // a pawn push stays on its file
+
+    bool reachesLastRank = type == PAWN && toR == (white ? 0 : 7);
+    if (reachesLastRank != (promotion != EMPTY)) return false;
+    if (promotion != EMPTY && pieceType(promotion) == KING) return false;
+
+    uint64_t origins = legalOrigins(makePiece(type, white), toR, toC);
+    for (uint64_t b = origins; b; b &= b - 1) {
+        int sq = lowestSquare(b);
+        if ((fromC >= 0 && sq % 8 != fromC) || (fromR >= 0 && sq / 8 != fromR)) origins &= ~(1ULL << sq);
     }
+    // Exactly one candidate left
+    if (origins == 0 || (origins & (origins - 1))) return false;
+
+    int from = lowestSquare(origins);
+    move = Move(from / 8, from % 8, toR, toC);
+    return true;
+}
+
+// A packMove value the side to move can legally play here, promotion piece included
+bool Engine::isLegalPackedMove(uint16_t m) {
+    int fromR = packedFrom(m) / 8, fromC = packedFrom(m) % 8;
+    int toR = packedTo(m) / 8, toC = packedTo(m) % 8;
+
+    Piece piece = boardLogic[fromR][fromC];
+    if (piece == EMPTY || isWhitePiece(piece) != whiteTurn) return false;
+    if (!(legalOrigins(piece, toR, toC) & squareBit(fromR, fromC))) return false;
+    bool promotes = pieceType(piece) == PAWN && (toR == 0 || toR == 7);
+    return promotes == (packedPromotion(m) != 0);
+}
+
+// Plays a packMove value on the board, unlogged, and passes the turn
+void Engine::playPackedMove(uint16_t m) {
+    int toR = packedTo(m) / 8, toC = packedTo(m) % 8;
+    playMove(packedFrom(m) / 8, packedFrom(m) % 8, toR, toC);
+    if (packedPromotion(m)) setSquare(toR, toC, makePiece(packedPromotion(m), whiteTurn));
+    whiteTurn = !whiteTurn;
+}
 
-    bool isCapture = (boardLogic[toR][toC] != ' ');
-    if (isCapture) {
-        if (toupper(piece) == 'P') {
-            san += char('a' + fromC);
+// Plays a solution line from its FEN and encodes each move. Leaves the board at the end
+// of the line.
+bool Engine::compilePuzzleLine(const string& fen, const vector<string>& line, bool uci, vector<uint16_t>& moves) {
+    moves.clear();
+    if (!loadBoardFromFEN(fen)) return false;
+
+    for (const string& text : line) {
+        int fromR, fromC, toR, toC;
+        Piece promotion = EMPTY;
+        if (uci) {
+            uint16_t m = encodeUciMove(text);
+            if (!m || !isLegalPackedMove(m)) return false;
+            fromR = packedFrom(m) / 8; fromC = packedFrom(m) % 8;
+            toR = packedTo(m) / 8; toC = packedTo(m) % 8;
+            if (packedPromotion(m)) promotion = makePiece(packedPromotion(m), whiteTurn);
+        }
+        else {
+            Move m;
+            if (!parseSAN(text, m, promotion)) return false;
+            fromR = m.sx; fromC = m.sy; toR = m.dx; toC = m.dy;
         }
-        san += 'x';
+
+        moves.push_back(packMove(fromR * 8 + fromC, toR * 8 + toC, pieceType(promotion)));
+        playPackedMove(moves.back());
     }
+    return !moves.empty();
+}
 
-    san += char('a' + toC);
-    san += char('8' - toR);
+// LineCompiler for ChessPuzzleSystem, on the game board
+bool compilePuzzleLine(const string& fen, const vector<string>& line, bool uci, vector<uint16_t>& moves) {
+    return game.compilePuzzleLine(fen, line, uci, moves);
+}
 
-    return san;
+// Positions along the current puzzle's solution, puzzleLine[k] being the game state after
+// k plies. Opponent replies and the reset after a wrong answer restore one of these
+// instead of playing moves or parsing the FEN again.
+std::vector<GameState> puzzleLine;
+
+// Walks the compiled line of a puzzle about to start, filling puzzleLine and writing the
+// SAN of imported (UCI) solutions for hints and the end screen. Leaves the board at the
+// start position.
+bool preparePuzzleLine(Puzzle& puzzle) {
+    puzzleLine.clear();
+    if (!game.loadBoardFromFEN(puzzle.fen)) return false;
+    puzzleLine.push_back(game.captureGameState());
+
+    if (puzzle.uciSolution) puzzle.solution.clear();
+    for (uint16_t m : puzzle.moves) {
+        if (puzzle.uciSolution) {
+            Piece promotion = packedPromotion(m) ? makePiece(packedPromotion(m), game.whiteTurn) : EMPTY;
+            puzzle.solution.push_back(game.moveToSAN(packedFrom(m) / 8, packedFrom(m) % 8,
+                                                packedTo(m) / 8, packedTo(m) % 8, promotion));
+        }
+        game.playPackedMove(m);
+        puzzleLine.push_back(game.captureGameState());
+    }
+    puzzle.uciSolution = false;
+
+    game.restoreGameState(puzzleLine[0]);
+    return true;
+}
+
+// Puts the board at a ply of the current puzzle's line
+void showPuzzlePly(int ply) {
+    if (puzzleLine.empty()) return;
+    game.restoreGameState(puzzleLine[std::min(ply, (int)puzzleLine.size() - 1)]);
+    game.clearMoveLog();
+}
+
+// ===================== PUZZLE VERIFICATION =====================
+
+// Plies searched below each candidate first move, and how far the intended move has to
+// stay ahead of every other one
+int verifyDepth = 4;
+const int VERIFY_MARGIN = 150;
+
+// Search score of playing 'm' for the side to move, in a window of (alpha, beta)
+int Engine::scoreRootMove(const Move& m, int depth, bool side, int alpha, int beta) {
+    SearchUndo undo;
+    makeSearchMove(m, undo);
+    int score = minimax(depth - 1, false, alpha, beta, side);
+    unmakeSearchMove(undo);
+    return score;
+}
+
+Move searchMoveFromPacked(uint16_t m) {
+    int promotion = packedPromotion(m) ? packedPromotion(m) : QUEEN;
+    return Move(packedFrom(m) / 8, packedFrom(m) % 8, packedTo(m) / 8, packedTo(m) % 8, promotion);
+}
+
+// PuzzleVerifier for ChessPuzzleSystem. Every move of the line has to be legal where it is
+// played, and the first one has to mate or beat each alternative by VERIFY_MARGIN. The
+// alternatives are probed with a null window around that bound, which is much cheaper
+// than scoring them.
+bool Engine::verifyPuzzleLine(const Puzzle& puzzle, string& reason) {
+    if (puzzle.moves.empty() || !loadBoardFromFEN(puzzle.fen)) {
+        reason = "no playable line";
+        return false;
+    }
+    for (size_t k = 0; k < puzzle.moves.size(); k++) {
+        if (!isLegalPackedMove(puzzle.moves[k])) {
+            reason = string(k % 2 ? "illegal reply " : "illegal move ") + uciMoveText(puzzle.moves[k]) +
+                     " at ply " + to_string(k + 1);
+            return false;
+        }
+        playPackedMove(puzzle.moves[k]);
+    }
+
+    loadBoardFromFEN(puzzle.fen);
+    bool side = whiteTurn;
+    Move intended = searchMoveFromPacked(puzzle.moves[0]);
+    int score = scoreRootMove(intended, verifyDepth, side);
+    if (score >= MATE_SCORE - 100) return true;
+
+    // The search only promotes to a queen, but the key move may be an underpromotion,
+    // so every promotion piece is an alternative here
+    int bound = score - VERIFY_MARGIN;
+    for (const Move& generated : generateAllMoves(side)) {
+        Piece mover = boardLogic[generated.sx][generated.sy];
+        bool promotes = pieceType(mover) == PAWN && (generated.dx == 0 || generated.dx == 7);
+
+        for (int promotion : { QUEEN, ROOK, BISHOP, KNIGHT }) {
+            Move m(generated.sx, generated.sy, generated.dx, generated.dy, promotion);
+            bool isIntended = m.sx == intended.sx && m.sy == intended.sy && m.dx == intended.dx &&
+                              m.dy == intended.dy && (!promotes || m.promotion == intended.promotion);
+
+            int alt = isIntended ? -999999 : scoreRootMove(m, verifyDepth, side, bound - 1, bound);
+            if (alt >= bound) {
+                reason = string(alt >= MATE_SCORE - 100 ? "misses a mate (" : "not unique (") +
+                         moveToSAN(m.sx, m.sy, m.dx, m.dy, promotes ? makePiece(promotion, side) : EMPTY) + ")";
+                return false;
+            }
+            if (!promotes) break;
+        }
+    }
+    return true;
+}
+
+// PuzzleVerifier for ChessPuzzleSystem. Each verification thread searches on an Engine of
+// its own, made the first time it is called there.
+bool verifyPuzzleLine(const Puzzle& puzzle, string& reason) {
+    thread_local std::unique_ptr<Engine> engine;
+    if (!engine) engine = std::make_unique<Engine>();
+    return engine->verifyPuzzleLine(puzzle, reason);
+}
+
+// ===================== ALTERNATIVE SOLUTIONS =====================
+
+// One frame at 60 Hz for the whole answer, of which the search gets three quarters to
+// leave room for unwinding, and how far below the intended move a different last move
+// may score and still count
+const double ALTERNATIVE_BUDGET_MS = 16.0;
+const int ALTERNATIVE_TOLERANCE = 50;
+
+// AlternativeJudge for ChessPuzzleSystem, working from the cached line of the puzzle on
+// screen. A move that mates is accepted at any point. Elsewhere the position would leave
+// the scripted line, so only the last move of the line is compared with the intended one:
+// both are searched one ply deeper at a time while the next depth, estimated from the
+// last, still fits the budget, and a depth cut off by the deadline is not used. The board
+// is left as it was.
+bool judgePuzzleAlternative(const Puzzle& puzzle, int ply, uint16_t move) {
+    if (ply >= (int)puzzleLine.size() || ply >= (int)puzzle.moves.size()) return false;
+
+    auto start = std::chrono::steady_clock::now();
+    GameState shown = game.captureGameState();
+    game.restoreGameState(puzzleLine[ply]);
+
+    bool accepted = false;
+    if (game.isLegalPackedMove(move)) {
+        game.playPackedMove(move);
+        accepted = game.isCheckmate(game.whiteTurn);
+        game.restoreGameState(puzzleLine[ply]);
+
+        if (!accepted && ply + 2 >= (int)puzzle.moves.size()) {
+            bool side = game.whiteTurn;
+            Move played = searchMoveFromPacked(move), intended = searchMoveFromPacked(puzzle.moves[ply]);
+            if (game.nnue.isLoaded()) game.nnue.refresh(game.boardLogic);
+
+            game.searchDeadline = start + std::chrono::microseconds((int)(ALTERNATIVE_BUDGET_MS * 750));
+            game.searchAborted = false;
+
+            bool searched = false;
+            int playedScore = 0, intendedScore = 0;
+            for (int depth = 1; depth <= 4; depth++) {
+                auto iteration = std::chrono::steady_clock::now();
+                int i = game.scoreRootMove(intended, depth, side);
+                int p = game.scoreRootMove(played, depth, side);
+                if (game.searchAborted) break;
+                intendedScore = i;
+                playedScore = p;
+                searched = true;
+
+                auto now = std::chrono::steady_clock::now();
+                double spent = std::chrono::duration<double, std::milli>(now - start).count();
+                double last = std::chrono::duration<double, std::milli>(now - iteration).count();
+                // Each ply costs this engine about 20 times the one before
+                if (spent + last * 20 > ALTERNATIVE_BUDGET_MS) break;
+            }
+            game.searchDeadline = std::chrono::steady_clock::time_point::max();
+            game.searchAborted = false;
+            accepted = searched && playedScore >= intendedScore - ALTERNATIVE_TOLERANCE;
+        }
+    }
+
+    game.restoreGameState(shown);
+    return accepted;
+}
+
+// ===================== PGN REPLAY =====================
+
+// Sets up a game read by PgnReader and plays its moves into the move log, calling
+// onPosition after each ply. Stops at the first move that is malformed or illegal.
+bool Engine::replayPgnGame(const PgnGame& pgn, const std::function<void(int ply)>& onPosition) {
+    std::string_view fen = pgn.tag("FEN");
+    if (fen.empty()) {
+        initializeBoardLogic();
+        whiteTurn = true;
+    }
+    else if (!loadBoardFromFEN(fen)) return false;
+
+    for (size_t i = 0; i < pgn.moves.size(); i++) {
+        Move m;
+        Piece promotion;
+        if (!parseSAN(pgn.moves[i], m, promotion)) return false;
+
+        logMove(m.sx, m.sy, m.dx, m.dy);
+        if (promotion != EMPTY) promoteLastMove(promotion);
+        whiteTurn = !whiteTurn;
+
+        if (onPosition) onPosition((int)i + 1);
+    }
+    return true;
+}
+
+// Batch mode: chess --replay-pgn <file> [threads]. Every worker maps and tokenises its
+// own chunk of the file and replays it on an Engine of its own.
+int runPgnReplay(const string& path, int threads) {
+    PgnReader reader;
+    if (!reader.open(path)) {
+        cout << "Cannot open " << path << endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Engine>> engines(threads);
+    std::atomic<size_t> replayed(0), rejected(0), plies(0);
+    auto start = std::chrono::steady_clock::now();
+
+    size_t games = reader.forEachGame([&](const PgnGame& pgn, int worker) {
+        std::unique_ptr<Engine>& engine = engines[worker];
+        if (!engine) engine = std::make_unique<Engine>();
+        if (engine->replayPgnGame(pgn)) replayed++;
+        else rejected++;
+        plies += engine->plyCursor;
+        return true;
+        }, threads);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cout << games << " games (" << replayed << " replayed, " << rejected << " rejected), "
+         << plies << " plies in " << seconds << " s, " << (size_t)(games / std::max(seconds, 1e-9)) << " games/s" << endl;
+    return 0;
 }
+
 void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
     Texture texW[6], texB[6];
     texW[0].loadFromFile("pieces/white-pawn.png");   texB[0].loadFromFile("pieces/black-pawn.png");
@@ -2344,11 +3522,39 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
 
     PuzzleDifficulty selectedDifficulty = PuzzleDifficulty::EASY;
 
-    Puzzle currentPuzzle = puzzleSystem.getNextPuzzle(selectedDifficulty);
-    puzzleSystem.startPuzzle(currentPuzzle);
+    // "Rated" picks around the player's own rating instead of from a tier
+    bool ratedMode = false;
+
+    // Theme filter, by tag so it survives the catalogue being rebuilt; empty for any theme.
+    // When nothing unsolved carries it, the pick falls back to the unfiltered one.
+    string themeFilter;
+    bool themeMissed = false;
+    auto pickPuzzle = [&]() {
+        themeMissed = false;
+        if (!themeFilter.empty()) {
+            int minRating, maxRating;
+            if (ratedMode) {
+                minRating = puzzleSystem.getRating() - 200;
+                maxRating = puzzleSystem.getRating() + 200;
+            }
+            else ChessPuzzleSystem::tierRatingRange(selectedDifficulty, minRating, maxRating);
+
+            Puzzle themed;
+            int theme = puzzleSystem.getThemeId(themeFilter);
+            if (theme >= 0 && puzzleSystem.findThemedPuzzle({ theme }, minRating, maxRating, themed)) return themed;
+            themeMissed = true;
+        }
+        return ratedMode ? puzzleSystem.getPuzzleNearRating(puzzleSystem.getRating())
+                         : puzzleSystem.getNextPuzzle(selectedDifficulty);
+    };
+    auto themeButtonLabel = [&]() {
+        string label = themeFilter.empty() ? "Any Theme" : ChessPuzzleSystem::themeLabel(themeFilter);
+        return label.size() > 16 ? label.substr(0, 14) + ".." : label;
+    };
 
-    loadBoardFromFEN(currentPuzzle.fen);
-    whiteTurn = currentPuzzle.whiteToMove;
+    Puzzle currentPuzzle = pickPuzzle();
+    preparePuzzleLine(currentPuzzle);
+    puzzleSystem.startPuzzle(currentPuzzle);
 
     bool puzzleComplete = false;
     Clock feedbackClock;
@@ -2420,7 +3626,7 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
     objectiveText.setFillColor(Color(255, 100, 100));
     objectiveText.setStyle(Text::Bold);
 
-    Text themeText("Theme: " + currentPuzzle.theme, font, 19);
+    Text themeText("Theme: " + ChessPuzzleSystem::themeLabel(currentPuzzle.theme), font, 19);
     themeText.setFillColor(Color(255, 200, 100));
 
     Text difficultyDisplayText("Difficulty: Easy", font, 19);
@@ -2430,12 +3636,12 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
     descText.setFillColor(Color::White);
 
     // Difficulty Buttons
-    vector<RectangleShape> difficultyButtons(4);
-    vector<Text> difficultyTexts(4);
-    string diffNames[] = { "Easy", "Intermediate", "Hard", "Ultra Hard" };
-    Color diffColors[] = { Color::Green, Color::Yellow, Color(255, 165, 0), Color::Red };
+    vector<RectangleShape> difficultyButtons(5);
+    vector<Text> difficultyTexts(5);
+    string diffNames[] = { "Easy", "Intermediate", "Hard", "Ultra Hard", "Rated" };
+    Color diffColors[] = { Color::Green, Color::Yellow, Color(255, 165, 0), Color::Red, Color::Cyan };
 
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < 5; i++) {
         difficultyButtons[i].setSize(Vector2f(140.f, 45.f));
         difficultyButtons[i].setFillColor(Color(60, 60, 60, 220));
         difficultyButtons[i].setOutlineThickness(2.f);
@@ -2447,6 +3653,14 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
         difficultyTexts[i].setFillColor(Color::White);
     }
 
+    // Theme button, beside "Rated": each click moves to the next tag in the catalogue
+    RectangleShape themeButton(Vector2f(140.f, 45.f));
+    themeButton.setFillColor(Color(60, 60, 60, 220));
+    themeButton.setOutlineThickness(2.f);
+    themeButton.setOutlineColor(Color(255, 200, 100));
+    Text themeButtonText(themeButtonLabel(), font, 15);
+    themeButtonText.setFillColor(Color::White);
+
     // Action Buttons
     RectangleShape hintButton(Vector2f(140.f, 50.f));
     hintButton.setFillColor(Color(70, 70, 150, 220));
@@ -2520,7 +3734,7 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
         // Difficulty buttons positioning
         float diffButtonStartY = infoBox.getPosition().y + 310.f;
         float diffButtonSpacing = 10.0f;
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < 5; i++) {
             int row = i / 2;
             int col = i % 2;
             difficultyButtons[i].setPosition(
@@ -2534,8 +3748,15 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
             );
         }
 
+        themeButton.setPosition(rightBoxX + 140.f + diffButtonSpacing, diffButtonStartY + 2.f * 55.f);
+        FloatRect themeBounds = themeButtonText.getLocalBounds();
+        themeButtonText.setPosition(
+            themeButton.getPosition().x + (140.f - themeBounds.width) / 2.f,
+            themeButton.getPosition().y + 14.f
+        );
+
         // Action buttons positioning
-        float actionButtonY = diffButtonStartY + 120.f;
+        float actionButtonY = diffButtonStartY + 175.f;
         hintButton.setPosition(rightBoxX, actionButtonY);
         hintButtonText.setPosition(hintButton.getPosition().x + 30.f, hintButton.getPosition().y + 12.f);
 
@@ -2558,17 +3779,26 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                 }
 
                 // Difficulty buttons
-                for (int i = 0; i < 4; i++) {
+                for (int i = 0; i < 5; i++) {
                     if (difficultyButtons[i].getGlobalBounds().contains(mousePos)) {
-                        selectedDifficulty = static_cast<PuzzleDifficulty>(i);
-                        currentPuzzle = puzzleSystem.getNextPuzzle(selectedDifficulty);
+                        // A tier the catalogue has no puzzles for stays unselected
+                        if (i < 4 && puzzleSystem.getPuzzleCount(static_cast<PuzzleDifficulty>(i)) == 0) {
+                            statusMessage.setString("No " + diffNames[i] + "\npuzzles loaded");
+                            statusMessage.setFillColor(Color::Yellow);
+                            showFeedback = true;
+                            feedbackClock.restart();
+                            continue;
+                        }
+                        ratedMode = i == 4;
+                        if (!ratedMode) selectedDifficulty = static_cast<PuzzleDifficulty>(i);
+                        currentPuzzle = pickPuzzle();
+                        preparePuzzleLine(currentPuzzle);
                         puzzleSystem.startPuzzle(currentPuzzle);
-                        loadBoardFromFEN(currentPuzzle.fen);
-                        whiteTurn = currentPuzzle.whiteToMove;
 
                         objectiveText.setString("Objective:\n" + currentPuzzle.objective);
-                        themeText.setString("Theme: " + currentPuzzle.theme);
-                        difficultyDisplayText.setString("Difficulty: " + diffNames[i]);
+                        themeText.setString("Theme: " + ChessPuzzleSystem::themeLabel(currentPuzzle.theme));
+                        difficultyDisplayText.setString("Difficulty: " + diffNames[i] +
+                            (ratedMode ? " " + to_string(currentPuzzle.rating) : ""));
                         descText.setString(currentPuzzle.description);
 
                         puzzleComplete = false;
@@ -2581,6 +3811,12 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                         statusMessage.setFillColor(Color::White);
                         puzzleTimer.restart();
                         aiThinking = false;
+                        if (themeMissed) {
+                            statusMessage.setString("No unsolved " + themeButtonLabel() + "\npuzzles here");
+                            statusMessage.setFillColor(Color::Yellow);
+                            showFeedback = true;
+                            feedbackClock.restart();
+                        }
                     }
                 }
 
@@ -2595,15 +3831,27 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                     feedbackClock.restart();
                 }
 
+                // Theme button: the next tag by name, back to any theme after the last,
+                // then a new puzzle as if Next had been pressed
+                bool nextPuzzle = nextButton.getGlobalBounds().contains(mousePos);
+                if (themeButton.getGlobalBounds().contains(mousePos)) {
+                    vector<string> names = puzzleSystem.getThemeNames();
+                    sort(names.begin(), names.end());
+                    auto next = upper_bound(names.begin(), names.end(), themeFilter);
+                    themeFilter = next == names.end() ? string() : *next;
+                    themeButtonText.setString(themeButtonLabel());
+                    nextPuzzle = true;
+                }
+
                 // Next puzzle button
-                if (nextButton.getGlobalBounds().contains(mousePos)) {
-                    currentPuzzle = puzzleSystem.getNextPuzzle(selectedDifficulty);
+                if (nextPuzzle) {
+                    currentPuzzle = pickPuzzle();
+                    preparePuzzleLine(currentPuzzle);
                     puzzleSystem.startPuzzle(currentPuzzle);
-                    loadBoardFromFEN(currentPuzzle.fen);
-                    whiteTurn = currentPuzzle.whiteToMove;
 
                     objectiveText.setString("Objective:\n" + currentPuzzle.objective);
-                    themeText.setString("Theme: " + currentPuzzle.theme);
+                    themeText.setString("Theme: " + ChessPuzzleSystem::themeLabel(currentPuzzle.theme));
+                    if (ratedMode) difficultyDisplayText.setString("Difficulty: Rated " + to_string(currentPuzzle.rating));
                     descText.setString(currentPuzzle.description);
                     ratingText.setString("Rating: " + to_string(puzzleSystem.getRating()));
                     streakText.setString("Streak: " + to_string(puzzleSystem.getStreak()) + " days");
@@ -2618,25 +3866,30 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                     statusMessage.setFillColor(Color::White);
                     puzzleTimer.restart();
                     aiThinking = false;
+                    if (themeMissed) {
+                        statusMessage.setString("No unsolved " + themeButtonLabel() + "\npuzzles here");
+                        statusMessage.setFillColor(Color::Yellow);
+                        showFeedback = true;
+                        feedbackClock.restart();
+                    }
                 }
 
                 // Piece dragging
-                if (!puzzleComplete && !aiThinking && whiteTurn == currentPuzzle.whiteToMove) {
+                if (!puzzleComplete && !aiThinking && game.whiteTurn == currentPuzzle.whiteToMove) {
                     int mx = ev.mouseButton.x;
                     int my = ev.mouseButton.y;
                     int col = (int)((mx - offX) / tileW);
                     int row = (int)((my - offY) / tileH);
 
-                    if (isInsideBoard(row, col) && boardArr[row][col] != 0) {
-                        char p = boardLogic[row][col];
-                        if ((currentPuzzle.whiteToMove && isupper(p)) ||
-                            (!currentPuzzle.whiteToMove && islower(p))) {
+                    if (isInsideBoard(row, col) && game.boardLogic[row][col] != EMPTY) {
+                        Piece p = game.boardLogic[row][col];
+                        if ((currentPuzzle.whiteToMove && isWhitePiece(p)) ||
+                            (!currentPuzzle.whiteToMove && isBlackPiece(p))) {
                             dragging = true;
                             dragR = row;
                             dragC = col;
-                            int id = boardArr[row][col];
                             dragSprite.setScale(0.75f, 0.75f);
-                            dragSprite.setTexture(id > 0 ? texW[id - 1] : texB[-id - 1]);
+                            dragSprite.setTexture(isWhitePiece(p) ? texW[pieceType(p) - 1] : texB[pieceType(p) - 1]);
                             dragOffsetX = (float)mx - ((float)col * tileW + offX);
                             dragOffsetY = (float)my - ((float)row * tileH + offY);
                         }
@@ -2652,12 +3905,18 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                     int col = (int)((mx - offX) / tileW);
                     int row = (int)((my - offY) / tileH);
 
-                    if (isInsideBoard(row, col) && isValidMove(dragR, dragC, row, col)) {
-                        string moveSAN = moveToSAN(dragR, dragC, row, col);
-                        makeMove(dragR, dragC, row, col);
-                        updateboard();
+                    if (isInsideBoard(row, col) && game.isValidMove(dragR, dragC, row, col)) {
+                        // The promotion piece is part of the move, so ask before moving
+                        Piece promotion = EMPTY;
+                        Piece moving = game.boardLogic[dragR][dragC];
+                        if ((moving == W_PAWN && row == 0) || (moving == B_PAWN && row == 7))
+                            promotion = showPromotionMenu(window, isWhitePiece(moving), texW, texB);
+
+                        uint16_t played = packMove(dragR * 8 + dragC, row * 8 + col, pieceType(promotion));
+                        game.makeMove(dragR, dragC, row, col);
+                        if (promotion != EMPTY) game.promoteLastMove(promotion);
 
-                        PuzzleResult result = puzzleSystem.checkMove(moveSAN);
+                        PuzzleResult result = puzzleSystem.checkMove(played);
 
                         if (result.isComplete) {
                             puzzleComplete = true;
@@ -2681,7 +3940,6 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                             statusMessage.setFillColor(Color::Green);
                             showFeedback = true;
                             feedbackClock.restart();
-                            whiteTurn = !whiteTurn;
                             aiThinking = true;
                             aiClock.restart();
                         }
@@ -2690,7 +3948,7 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
                             statusMessage.setFillColor(Color::Red);
                             showFeedback = true;
                             feedbackClock.restart();
-                            loadBoardFromFEN(currentPuzzle.fen);
+                            showPuzzlePly(puzzleSystem.getPly());
 
                             int remaining = puzzleSystem.getRemainingAttempts();
                             attemptsText.setString("Attempts: " + to_string(remaining) + "/3");
@@ -2708,10 +3966,10 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
             }
         }
 
-        // AI move after delay
+        // Opponent's reply after delay, straight from the cached line
         if (aiThinking && aiClock.getElapsedTime().asSeconds() >= AI_DELAY) {
             if (puzzleSystem.hasPuzzle()) {
-                whiteTurn = !whiteTurn;
+                showPuzzlePly(puzzleSystem.getPly());
             }
             aiThinking = false;
         }
@@ -2736,18 +3994,27 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
         // Hover effects
         Vector2i mousePos = Mouse::getPosition(window);
 
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < 5; i++) {
             if (difficultyButtons[i].getGlobalBounds().contains((float)mousePos.x, (float)mousePos.y)) {
                 difficultyButtons[i].setFillColor(Color(100, 100, 100, 240));
             }
             else {
+                bool selected = ratedMode ? i == 4 : i < 4 && static_cast<PuzzleDifficulty>(i) == selectedDifficulty;
+                bool empty = i < 4 && puzzleSystem.getPuzzleCount(static_cast<PuzzleDifficulty>(i)) == 0;
                 difficultyButtons[i].setFillColor(
-                    static_cast<PuzzleDifficulty>(i) == selectedDifficulty ?
-                    Color(90, 90, 90, 240) : Color(60, 60, 60, 220)
+                    selected ? Color(90, 90, 90, 240) :
+                    empty ? Color(40, 40, 40, 160) : Color(60, 60, 60, 220)
                 );
             }
         }
 
+        if (themeButton.getGlobalBounds().contains((float)mousePos.x, (float)mousePos.y)) {
+            themeButton.setFillColor(Color(100, 100, 100, 240));
+        }
+        else {
+            themeButton.setFillColor(themeFilter.empty() ? Color(60, 60, 60, 220) : Color(90, 90, 90, 240));
+        }
+
         if (hintButton.getGlobalBounds().contains((float)mousePos.x, (float)mousePos.y)) {
             hintButton.setFillColor(Color(100, 100, 200, 240));
         }
@@ -2801,10 +4068,12 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
         window.draw(difficultyDisplayText);
         window.draw(descText);
 
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < 5; i++) {
             window.draw(difficultyButtons[i]);
             window.draw(difficultyTexts[i]);
         }
+        window.draw(themeButton);
+        window.draw(themeButtonText);
 
         window.draw(hintButton);
         window.draw(hintButtonText);
@@ -2819,7 +4088,7 @@ void runPuzzleMode(RenderWindow& window, ChessPuzzleSystem& puzzleSystem) {
 // =======================
 //  MAIN
 // =======================
-int main() {
+int runChessApp() {
     // ---------------- WINDOW SETUP ----------------     
     VideoMode desk = VideoMode::getDesktopMode();
     RenderWindow window(desk, "Chess", Style::Default);
@@ -2839,9 +4108,21 @@ int main() {
     float menuVolume = 40.f;
     float currentVolume = menuVolume;
 
-    ChessPuzzleSystem puzzleSystem;
-    puzzleSystem.initializePuzzles();
-    puzzleSystem.loadProgress();
+    if (!game.nnue.isLoaded() && !game.nnue.load(NNUE_WEIGHTS_FILE)) {
+        cout << "NNUE weights not found, using classical evaluation" << endl;
+    }
+
+    // Kept across returns to the menu, so a large puzzle file is read only once
+    static ChessPuzzleSystem puzzleSystem;
+    static bool puzzlesLoaded = false;
+    if (!puzzlesLoaded) {
+        puzzleSystem.setLineCompiler(compilePuzzleLine);
+        puzzleSystem.setAlternativeJudge(judgePuzzleAlternative);
+        if (!puzzleSystem.openPuzzlePack(PUZZLE_PACK_FILE) && !puzzleSystem.loadPuzzlesCSV(PUZZLE_CSV_FILE))
+            puzzleSystem.initializePuzzles();
+        puzzleSystem.loadProgress();
+        puzzlesLoaded = true;
+    }
 
     // ---------------- VOLUME SLIDER (MENU) ----------------
     RectangleShape sliderBar(Vector2f(200.f, 5.f));
@@ -2924,7 +4205,7 @@ int main() {
     if (choice == 4) {
         runPuzzleMode(window, puzzleSystem);
         puzzleSystem.saveProgress();
-        return main();
+        return runChessApp();
     }
 
     // ---------------- STOP MENU MUSIC ----------------
@@ -2943,7 +4224,7 @@ int main() {
         }
 
         if (diffChoice == 0) {
-            return main();  // Back button - restart from main menu
+            return runChessApp();  // Back button - restart from main menu
         }
 
         aiDifficulty = static_cast<AILevel>(std::max(0, std::min(diffChoice - 1, 2)));
@@ -2958,7 +4239,7 @@ int main() {
     }
 
     if (selectedTheme == -1) {
-        return main();  // Back button - restart from main menu
+        return runChessApp();  // Back button - restart from main menu
     }
 
     // Define board themes
@@ -2974,8 +4255,7 @@ int main() {
     darkColor = themes[selectedTheme].darkTile;
     // ---------------- INIT BOARD ----------------     
     srand(static_cast<unsigned>(time(nullptr)));
-    initializeBoardLogic();
-    updateboard();
+    game.initializeBoardLogic();
 
     // ---------------- SOUNDS ----------------     
     moveBuffer.loadFromFile("audio/move.wav");
@@ -3024,7 +4304,7 @@ int main() {
     Clock aiClock;
 
     bool gameOver = false;
-    whiteTurn = true;
+    game.whiteTurn = true;
     int dragR = -1, dragC = -1;
     int hoverRow = -1, hoverCol = -1;
 
@@ -3070,18 +4350,36 @@ int main() {
     undoText.setPosition(undoButton.getPosition().x + 15.f, undoButton.getPosition().y + 8.f);
     redoText.setPosition(redoButton.getPosition().x + 15.f, redoButton.getPosition().y + 8.f);
 
+    // ---------------- MOVE HISTORY BAR ----------------
+    RectangleShape historyBar(Vector2f(180.f, 4.f));
+    historyBar.setFillColor(Color::White);
+    historyBar.setPosition(20.f, 80.f);
+
+    RectangleShape historyKnob(Vector2f(12.f, 16.f));
+    historyKnob.setFillColor(Color::Red);
+    historyKnob.setOrigin(historyKnob.getSize().x / 2.f, historyKnob.getSize().y / 2.f);
+
+    bool draggingHistory = false;
+
+    // Ply under an x coordinate of the history bar
+    auto historyPlyAt = [&](float mx) {
+        float barX = historyBar.getPosition().x;
+        float t = (mx - barX) / historyBar.getSize().x;
+        t = std::max(0.f, std::min(1.f, t));
+        return (int)(t * game.moveLog.size() + 0.5f);
+        };
+
     // ---------------- RESET FUNCTION ----------------     
     auto resetGame = [&]() {
-        initializeBoardLogic();
-        updateboard();
-        whiteTurn = true;
+        game.initializeBoardLogic();
+        game.whiteTurn = true;
         gameOver = false;
         dragR = dragC = hoverRow = hoverCol = -1;
         for (int i = 0; i < 16; i++) {
-            whiteCaptured[i] = ' ';
-            blackCaptured[i] = ' ';
+            game.whiteCaptured[i] = EMPTY;
+            game.blackCaptured[i] = EMPTY;
         }
-        whiteCapCount = blackCapCount = 0;
+        game.whiteCapCount = game.blackCapCount = 0;
         };
 
     // ---------------- ENDGAME OVERLAY ----------------     
@@ -3118,7 +4416,7 @@ int main() {
         };
 
     // ---------------- INIT AI THINKING FOR FIRST MOVE ----------------
-    if (AIenabled && whiteTurn == AIisWhite) {
+    if (AIenabled && game.whiteTurn == AIisWhite) {
         aiThinking = true;
         aiClock.restart();
     }
@@ -3147,6 +4445,22 @@ int main() {
                 captureSound.setVolume(vol);
             }
 
+            // ---------------- EXPORT POSITION ----------------
+            if (ev.type == Event::KeyPressed && ev.key.code == Keyboard::F) {
+                cout << "FEN: " << game.boardToFEN() << endl;
+            }
+
+            // ---------------- JUMP TO FIRST / LAST MOVE ----------------
+            if (ev.type == Event::KeyPressed && !aiThinking &&
+                (ev.key.code == Keyboard::Home || ev.key.code == Keyboard::End)) {
+                game.seekToPly(ev.key.code == Keyboard::Home ? 0 : (int)game.moveLog.size(), aiThinking);
+
+                if (AIenabled && game.whiteTurn == AIisWhite) {
+                    aiThinking = true;
+                    aiClock.restart();
+                }
+            }
+
             if (ev.type == Event::MouseButtonPressed &&
                 ev.mouseButton.button == Mouse::Left)
             {
@@ -3154,22 +4468,20 @@ int main() {
 
                 // ---------------- UNDO / REDO BUTTONS ----------------
                 if (undoButton.getGlobalBounds().contains(mousePos) && !aiThinking) {
-                    undoMove(aiThinking);
-                    updateboard();
+                    game.undoMove(aiThinking);
 
                     // ADDED: If it's AI's turn after undo, start AI thinking
-                    if (AIenabled && whiteTurn == AIisWhite) {
+                    if (AIenabled && game.whiteTurn == AIisWhite) {
                         aiThinking = true;
                         aiClock.restart();
                     }
                 }
 
                 if (redoButton.getGlobalBounds().contains(mousePos) && !aiThinking) {
-                    redoMove(aiThinking);
-                    updateboard();
+                    game.redoMove(aiThinking);
 
                     // ADDED: If it's AI's turn after redo, start AI thinking
-                    if (AIenabled && whiteTurn == AIisWhite) {
+                    if (AIenabled && game.whiteTurn == AIisWhite) {
                         aiThinking = true;
                         aiClock.restart();
                     }
@@ -3179,22 +4491,30 @@ int main() {
                 // ---------------- GAME SLIDER ----------------
                 if (gameSliderKnob.getGlobalBounds().contains(mousePos)) draggingGameSlider = true;
 
+                // ---------------- MOVE HISTORY BAR ----------------
+                FloatRect historyArea = historyBar.getGlobalBounds();
+                historyArea.top -= 8.f;
+                historyArea.height += 16.f;
+                if (historyArea.contains(mousePos) && !aiThinking) {
+                    draggingHistory = true;
+                    game.seekToPly(historyPlyAt(mousePos.x), aiThinking);
+                }
+
                 // ---------------- DRAGGING PIECES ----------------
-                bool humanTurn = !(AIenabled && whiteTurn == AIisWhite);
+                bool humanTurn = !(AIenabled && game.whiteTurn == AIisWhite);
                 if (humanTurn) {
                     int mx = ev.mouseButton.x;
                     int my = ev.mouseButton.y;
                     int col = (mx - offX) / tileW;
                     int row = (my - offY) / tileH;
 
-                    if (isInsideBoard(row, col) && boardArr[row][col] != 0) {
-                        char p = boardLogic[row][col];
-                        if ((whiteTurn && isupper(p)) || (!whiteTurn && islower(p))) {
+                    if (isInsideBoard(row, col) && game.boardLogic[row][col] != EMPTY) {
+                        Piece p = game.boardLogic[row][col];
+                        if ((game.whiteTurn && isWhitePiece(p)) || (!game.whiteTurn && isBlackPiece(p))) {
                             dragging = true;
                             dragR = row; dragC = col;
-                            int id = boardArr[row][col];
                             dragSprite.setScale(0.75f, 0.75f);
-                            dragSprite.setTexture(id > 0 ? texW[id - 1] : texB[-id - 1]);
+                            dragSprite.setTexture(isWhitePiece(p) ? texW[pieceType(p) - 1] : texB[pieceType(p) - 1]);
                             dragOffsetX = mx - (col * tileW + offX);
                             dragOffsetY = my - (row * tileH + offY);
                         }
@@ -3207,6 +4527,16 @@ int main() {
             {
                 draggingGameSlider = false;
 
+                if (draggingHistory) {
+                    draggingHistory = false;
+
+                    // Same as after undo: let the AI move if the position is its turn
+                    if (AIenabled && game.whiteTurn == AIisWhite) {
+                        aiThinking = true;
+                        aiClock.restart();
+                    }
+                }
+
                 if (dragging) {
                     dragging = false;
                     int mx = ev.mouseButton.x;
@@ -3214,43 +4544,50 @@ int main() {
                     int col = (mx - offX) / tileW;
                     int row = (my - offY) / tileH;
 
-                    if (isInsideBoard(row, col) && isValidMove(dragR, dragC, row, col)) {
-                        recordStateBeforeMove();
-                        makeMove(dragR, dragC, row, col);
-                        updateboard();
+                    if (isInsideBoard(row, col) && game.isValidMove(dragR, dragC, row, col)) {
+                        game.makeMove(dragR, dragC, row, col);
                         moveSound.play();
 
-                        if ((boardLogic[row][col] == 'P' && row == 0) ||
-                            (boardLogic[row][col] == 'p' && row == 7)) {
-                            bool isWhite = isupper(boardLogic[row][col]);
-                            boardLogic[row][col] = showPromotionMenu(window, isWhite, texW, texB);
-                            updateboard();
+                        if ((game.boardLogic[row][col] == W_PAWN && row == 0) ||
+                            (game.boardLogic[row][col] == B_PAWN && row == 7)) {
+                            bool isWhite = isWhitePiece(game.boardLogic[row][col]);
+                            game.promoteLastMove(showPromotionMenu(window, isWhite, texW, texB));
                         }
 
                         // ---------- CHECK ENDGAME ----------
-                        if (isCheckmate(!whiteTurn)) {
+                        if (game.isCheckmate(!game.whiteTurn)) {
                             gameOver = true;
                             checkmateSound.play();
-                            showEndOverlay(whiteTurn ? "Checkmate by White!" : "Checkmate by Black!");
-                            int res = showEndGameMenu(window, whiteTurn ? "White wins by Checkmate!" : "Black wins by Checkmate!");
+                            showEndOverlay(game.whiteTurn ? "Checkmate by White!" : "Checkmate by Black!");
+                            int res = showEndGameMenu(window, game.whiteTurn ? "White wins by Checkmate!" : "Black wins by Checkmate!");
                             if (res == 0) {
-                                resetGame(); return main();
+                                resetGame(); return runChessApp();
                             }
                             else return 0;
                         }
-                        else if (isStalemate(!whiteTurn)) {
+                        else if (game.isStalemate(!game.whiteTurn)) {
                             gameOver = true;
                             stalemateSound.play();
                             showEndOverlay("Stalemate! Draw!");
                             int res = showEndGameMenu(window, "Stalemate! Draw!");
                             if (res == 0) {
-                                resetGame(); return main();
+                                resetGame(); return runChessApp();
+                            }
+                            else return 0;
+                        }
+                        else if (const char* draw = game.drawByRule(!game.whiteTurn)) {
+                            gameOver = true;
+                            stalemateSound.play();
+                            showEndOverlay(draw);
+                            int res = showEndGameMenu(window, draw);
+                            if (res == 0) {
+                                resetGame(); return runChessApp();
                             }
                             else return 0;
                         }
 
-                        whiteTurn = !whiteTurn;
-                        if (AIenabled && whiteTurn == AIisWhite) {
+                        game.whiteTurn = !game.whiteTurn;
+                        if (AIenabled && game.whiteTurn == AIisWhite) {
                             aiThinking = true;
                             aiClock.restart();
                         }
@@ -3262,6 +4599,8 @@ int main() {
                 hoverCol = (ev.mouseMove.x - offX) / tileW;
                 hoverRow = (ev.mouseMove.y - offY) / tileH;
 
+                if (draggingHistory) game.seekToPly(historyPlyAt((float)ev.mouseMove.x), aiThinking);
+
                 if (draggingGameSlider) {
                     float mx = ev.mouseMove.x;
                     float barX = gameSliderBar.getPosition().x;
@@ -3286,28 +4625,27 @@ int main() {
 
         // ---------------- AI MOVE ----------------
         if (!gameOver && aiThinking) {
-            applyAIMove(AIisWhite);
-            updateboard();
+            game.applyAIMove(AIisWhite);
             moveSound.play();
-            whiteTurn = !whiteTurn;
+            game.whiteTurn = !game.whiteTurn;
             aiThinking = false;
 
             // ADDED: Check game over after AI move
-            if (isCheckmate(!whiteTurn)) {
+            if (game.isCheckmate(!game.whiteTurn)) {
                 gameOver = true;
                 checkmateSound.play();
-                showEndOverlay(!whiteTurn ? "Checkmate by White!" : "Checkmate by Black!");
-                int res = showEndGameMenu(window, !whiteTurn ? "White wins by Checkmate!" : "Black wins by Checkmate!");
+                showEndOverlay(!game.whiteTurn ? "Checkmate by White!" : "Checkmate by Black!");
+                int res = showEndGameMenu(window, !game.whiteTurn ? "White wins by Checkmate!" : "Black wins by Checkmate!");
                 if (res == 0) {
                     resetGame();
                     // Restart game logic here
-                    return main();
+                    return runChessApp();
                 }
                 else {
                     window.close();
                 }
             }
-            else if (isStalemate(!whiteTurn)) {
+            else if (game.isStalemate(!game.whiteTurn)) {
                 gameOver = true;
                 stalemateSound.play();
                 showEndOverlay("Stalemate! Draw!");
@@ -3315,7 +4653,20 @@ int main() {
                 if (res == 0) {
                     resetGame();
                     // Restart game logic here
-                    return main();
+                    return runChessApp();
+                }
+                else {
+                    window.close();
+                }
+            }
+            else if (const char* draw = game.drawByRule(game.whiteTurn)) {
+                gameOver = true;
+                stalemateSound.play();
+                showEndOverlay(draw);
+                int res = showEndGameMenu(window, draw);
+                if (res == 0) {
+                    resetGame();
+                    return runChessApp();
                 }
                 else {
                     window.close();
@@ -3354,11 +4705,18 @@ int main() {
         window.draw(gameSliderBar);
         window.draw(gameSliderKnob);
 
+        // ---------------- DRAW MOVE HISTORY BAR ----------------
+        float historyT = game.moveLog.empty() ? 1.f : (float)game.plyCursor / game.moveLog.size();
+        historyKnob.setPosition(historyBar.getPosition().x + historyBar.getSize().x * historyT,
+            historyBar.getPosition().y + historyBar.getSize().y / 2.f);
+        window.draw(historyBar);
+        window.draw(historyKnob);
+
         // ---------------- DRAW UNDO / REDO BUTTONS ----------------
-        if (undoStack.empty()) undoButton.setFillColor(Color(80, 80, 80, 180));
+        if (game.plyCursor == 0) undoButton.setFillColor(Color(80, 80, 80, 180));
         else undoButton.setFillColor(Color(50, 50, 50, 220));
 
-        if (redoStack.empty()) redoButton.setFillColor(Color(80, 80, 80, 180));
+        if (game.plyCursor == (int)game.moveLog.size()) redoButton.setFillColor(Color(80, 80, 80, 180));
         else redoButton.setFillColor(Color(50, 50, 50, 220));
 
         window.draw(undoButton);
@@ -3372,5 +4730,26 @@ int main() {
     return 0;
 }
 
+int main(int argc, char** argv) {
+    // ---------------- BATCH TOOLS ----------------
+    if (argc >= 3 && string(argv[1]) == "--replay-pgn") {
+        int threads = argc >= 4 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+        return runPgnReplay(argv[2], std::max(threads, 1));
+    }
+    if (argc >= 4 && string(argv[1]) == "--build-puzzle-pack") {
+        ChessPuzzleSystem builder;
+        builder.setLineCompiler(compilePuzzleLine);
+        if (!builder.loadPuzzlesCSV(argv[2])) {
+            cout << "No puzzles read from " << argv[2] << endl;
+            return 1;
+        }
+        // Optional engine check: --build-puzzle-pack <csv> <pack> <reject report> [depth]
+        if (argc >= 5) {
+            if (argc >= 6) verifyDepth = std::max(atoi(argv[5]), 1);
+            builder.verifyCatalogue(verifyPuzzleLine, argv[4]);
+        }
+        return builder.savePuzzlePack(argv[3]) ? 0 : 1;
+    }
 
-
+    return runChessApp();
+}
@@ -0,0 +1,53 @@
+#ifndef CHESSPIECE_H
+#define CHESSPIECE_H
+
+#include <cstdint>
+
+// One byte per square: bit 3 is set for Black, bits 0-2 hold the type.
+// Types follow the piece texture order, so (type - 1) indexes the sprite arrays.
+typedef uint8_t Piece;
+
+enum PieceType {
+    PAWN = 1,
+    ROOK = 2,
+    KNIGHT = 3,
+    BISHOP = 4,
+    QUEEN = 5,
+    KING = 6
+};
+
+const Piece EMPTY = 0;
+const Piece TYPE_MASK = 7;
+const Piece BLACK_BIT = 8;
+
+const Piece W_PAWN = PAWN, W_ROOK = ROOK, W_KNIGHT = KNIGHT, W_BISHOP = BISHOP, W_QUEEN = QUEEN, W_KING = KING;
+const Piece B_PAWN = BLACK_BIT | PAWN, B_ROOK = BLACK_BIT | ROOK, B_KNIGHT = BLACK_BIT | KNIGHT,
+            B_BISHOP = BLACK_BIT | BISHOP, B_QUEEN = BLACK_BIT | QUEEN, B_KING = BLACK_BIT | KING;
+
+// Side to move; also the index of per-side arrays such as the piece lists
+enum Side { WHITE = 0, BLACK = 1 };
+constexpr Side opposite(Side s) { return s == WHITE ? BLACK : WHITE; }
+
+inline int pieceType(Piece p) { return p & TYPE_MASK; }
+inline bool isWhitePiece(Piece p) { return p != EMPTY && !(p & BLACK_BIT); }
+inline bool isBlackPiece(Piece p) { return (p & BLACK_BIT) != 0; }
+inline Piece makePiece(int type, bool white) { return (Piece)(white ? type : type | BLACK_BIT); }
+template<Side S> constexpr Piece sidePiece(int type) { return (Piece)(S == WHITE ? type : type | BLACK_BIT); }
+
+// FEN letters <-> codes; unknown letters read as EMPTY, EMPTY prints as ' '
+inline Piece pieceFromChar(char c) {
+    switch (c) {
+    case 'P': return W_PAWN;   case 'p': return B_PAWN;
+    case 'R': return W_ROOK;   case 'r': return B_ROOK;
+    case 'N': return W_KNIGHT; case 'n': return B_KNIGHT;
+    case 'B': return W_BISHOP; case 'b': return B_BISHOP;
+    case 'Q': return W_QUEEN;  case 'q': return B_QUEEN;
+    case 'K': return W_KING;   case 'k': return B_KING;
+    }
+    return EMPTY;
+}
+inline char pieceToChar(Piece p) {
+    return " PRNBQK  prnbqk "[p & 15];
+}
+
+#endif
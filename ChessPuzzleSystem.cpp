@@ -1,22 +1,46 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "ChessPuzzleSystem.h"
+#include "FenParser.h"
+#include "MappedFile.h"
 #include <algorithm>
+#include <cctype>
+#include <climits>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 ChessPuzzleSystem::ChessPuzzleSystem()
-    : currentPuzzle(nullptr), userRating(1200), streakCount(0),
+    : rng((unsigned)time(0)), currentPuzzle(nullptr), userRating(1200), streakCount(0),
     lastSolvedDate(0), moveIndex(0), attempts(0), hintsUsed(0),
-    currentDifficulty(PuzzleDifficulty::EASY), currentIndexInDifficulty(0) {
+    currentDifficulty(PuzzleDifficulty::EASY), currentIndexInDifficulty(0),
+    lineCompiler(nullptr), alternativeJudge(nullptr) {
+    fill(tierStart, tierStart + 5, (size_t)0);
 }
 
 ChessPuzzleSystem::~ChessPuzzleSystem() {
     if (currentPuzzle) delete currentPuzzle;
 }
 
+// Rating of the built-in puzzles, which only have a tier
+static int tierRating(PuzzleDifficulty difficulty) {
+    switch (difficulty) {
+    case PuzzleDifficulty::EASY: return 800;
+    case PuzzleDifficulty::INTERMEDIATE: return 1200;
+    case PuzzleDifficulty::HARD: return 1600;
+    case PuzzleDifficulty::ULTRA_HARD: return 2000;
+    }
+    return 800;
+}
+
 void ChessPuzzleSystem::initializePuzzles() {
+    pack.close();
     easyPuzzles.clear();
     intermediatePuzzles.clear();
     hardPuzzles.clear();
@@ -29,7 +53,7 @@ void ChessPuzzleSystem::initializePuzzles() {
     e1.fen = "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1";
     e1.solution = { "Ra8#" };
     e1.difficulty = PuzzleDifficulty::EASY;
-    e1.theme = "Back Rank Mate";
+    e1.theme = "backRankMate";
     e1.description = "White to move";
     e1.objective = "Checkmate the King";
     e1.whiteToMove = true;
@@ -37,12 +61,12 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle e2;
     e2.id = 2;
-    e2.fen = "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 0 1";
-    e2.solution = { "Nxe4" };
+    e2.fen = "6k1/pp3ppp/3q4/8/6n1/8/PP3PPP/3Q1RK1 b - - 0 1";
+    e2.solution = { "Qxh2#" };
     e2.difficulty = PuzzleDifficulty::EASY;
-    e2.theme = "Knight Fork";
+    e2.theme = "queenCheckmate";
     e2.description = "Black to move";
-    e2.objective = "Win material with fork";
+    e2.objective = "Checkmate the King";
     e2.whiteToMove = false;
     easyPuzzles.push_back(e2);
 
@@ -51,7 +75,7 @@ void ChessPuzzleSystem::initializePuzzles() {
     e3.fen = "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 0 1";
     e3.solution = { "Qxf7#" };
     e3.difficulty = PuzzleDifficulty::EASY;
-    e3.theme = "Queen Checkmate";
+    e3.theme = "queenCheckmate";
     e3.description = "White to move";
     e3.objective = "Checkmate the King";
     e3.whiteToMove = true;
@@ -59,56 +83,57 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle e4;
     e4.id = 4;
-    e4.fen = "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 0 1";
-    e4.solution = { "Qg5" };
+    e4.fen = "6k1/5ppp/8/8/8/5pPq/5P1P/6K1 b - - 0 1";
+    e4.solution = { "Qg2#" };
     e4.difficulty = PuzzleDifficulty::EASY;
-    e4.theme = "Attack Queen";
+    e4.theme = "pawnSupportedMate";
     e4.description = "Black to move";
-    e4.objective = "Win the Queen";
+    e4.objective = "Checkmate the King";
     e4.whiteToMove = false;
     easyPuzzles.push_back(e4);
 
     Puzzle e5;
     e5.id = 5;
-    e5.fen = "r1bqkbnr/ppp2ppp/2np4/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 0 1";
-    e5.solution = { "Bxf7+" };
+    e5.fen = "R7/7k/8/5NpP/8/8/2K5/6R1 w - g6 0 1";
+    e5.solution = { "hxg6#" };
     e5.difficulty = PuzzleDifficulty::EASY;
-    e5.theme = "Pin and Check";
+    e5.theme = "enPassant";
     e5.description = "White to move";
-    e5.objective = "Win the pawn with check";
+    e5.objective = "Checkmate the King";
     e5.whiteToMove = true;
     easyPuzzles.push_back(e5);
 
+
     // ==================== INTERMEDIATE PUZZLES (5) ====================
 
     Puzzle i1;
     i1.id = 6;
-    i1.fen = "r1bqk2r/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQK2R w KQkq - 0 1";
-    i1.solution = { "Bxf7+", "Kxf7", "Ng5+" };
+    i1.fen = "8/8/8/8/2k4r/8/8/R5K1 w - - 0 1";
+    i1.solution = { "Ra4+", "Kd5", "Rxh4" };
     i1.difficulty = PuzzleDifficulty::INTERMEDIATE;
-    i1.theme = "Discovered Attack";
+    i1.theme = "skewer";
     i1.description = "White to move";
-    i1.objective = "Win the Queen";
+    i1.objective = "Win the Rook";
     i1.whiteToMove = true;
     intermediatePuzzles.push_back(i1);
 
     Puzzle i2;
     i2.id = 7;
-    i2.fen = "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R b KQkq - 0 1";
-    i2.solution = { "Nxe4", "Nxe4", "d5" };
+    i2.fen = "6k1/pp3ppp/8/7b/3n4/8/PP3PPP/2Q3K1 b - - 0 1";
+    i2.solution = { "Ne2+", "Kf1", "Nxc1" };
     i2.difficulty = PuzzleDifficulty::INTERMEDIATE;
-    i2.theme = "Double Attack";
+    i2.theme = "knightFork";
     i2.description = "Black to move";
-    i2.objective = "Win the Bishop";
+    i2.objective = "Win the Queen";
     i2.whiteToMove = false;
     intermediatePuzzles.push_back(i2);
 
     Puzzle i3;
     i3.id = 8;
-    i3.fen = "4r1k1/5ppp/8/8/8/8/5PPP/4R1K1 w - - 0 1";
-    i3.solution = { "Re8+", "Rxe8" };
+    i3.fen = "r3k3/5ppp/8/3N4/8/8/5PPP/6K1 w - - 0 1";
+    i3.solution = { "Nc7+", "Kd7", "Nxa8" };
     i3.difficulty = PuzzleDifficulty::INTERMEDIATE;
-    i3.theme = "Skewer";
+    i3.theme = "knightFork";
     i3.description = "White to move";
     i3.objective = "Win the Rook";
     i3.whiteToMove = true;
@@ -116,34 +141,35 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle i4;
     i4.id = 9;
-    i4.fen = "8/4P3/8/8/8/4k3/8/4K3 w - - 0 1";
-    i4.solution = { "e8=Q+" };
+    i4.fen = "8/2q1P1k1/8/8/8/8/PP6/1K6 w - - 0 1";
+    i4.solution = { "e8=N+", "Kf7", "Nxc7" };
     i4.difficulty = PuzzleDifficulty::INTERMEDIATE;
-    i4.theme = "Promotion";
+    i4.theme = "underPromotion";
     i4.description = "White to move";
-    i4.objective = "Promote the pawn with check";
+    i4.objective = "Promote and win the Queen";
     i4.whiteToMove = true;
     intermediatePuzzles.push_back(i4);
 
     Puzzle i5;
     i5.id = 10;
-    i5.fen = "r3k2r/ppp2ppp/2n5/3q4/3P4/2PQ4/PP3PPP/R3K2R b KQkq - 0 1";
-    i5.solution = { "Qxd4", "Qxd4", "Nxd4" };
+    i5.fen = "3r2k1/pp3ppp/8/8/q2Q4/8/PP3PPP/3R2K1 b - - 0 1";
+    i5.solution = { "Qxd1+", "Qxd1", "Rxd1#" };
     i5.difficulty = PuzzleDifficulty::INTERMEDIATE;
-    i5.theme = "Deflection";
+    i5.theme = "backRankMate";
     i5.description = "Black to move";
-    i5.objective = "Win material";
+    i5.objective = "Checkmate the King";
     i5.whiteToMove = false;
     intermediatePuzzles.push_back(i5);
 
+
     // ==================== HARD PUZZLES (5) ====================
 
     Puzzle h1;
     h1.id = 11;
-    h1.fen = "r2qkb1r/ppp2ppp/2n5/3pP3/3Pn1b1/2PB1N2/PP3PPP/RNBQK2R b KQkq - 0 1";
-    h1.solution = { "Nxf2", "Kxf2", "Qh4+", "g3", "Qxg3#" };
+    h1.fen = "6k1/pp3ppp/8/2q5/8/7n/PP4PP/3Q1R1K b - - 0 1";
+    h1.solution = { "Qg1+", "Rxg1", "Nf2#" };
     h1.difficulty = PuzzleDifficulty::HARD;
-    h1.theme = "Sacrificial Attack";
+    h1.theme = "smotheredMate";
     h1.description = "Black to move";
     h1.objective = "Checkmate the King";
     h1.whiteToMove = false;
@@ -151,56 +177,57 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle h2;
     h2.id = 12;
-    h2.fen = "r1bqk2r/ppp2ppp/2n5/2bpP3/8/2PB1Q2/PP3PPP/RNB1K1NR w KQkq - 0 1";
-    h2.solution = { "Qxf7+", "Kxf7", "Bc4+" };
+    h2.fen = "r4r1k/pppq2pp/8/5P1Q/2B5/4R3/PPP3PP/6K1 w - - 0 1";
+    h2.solution = { "Qxh7+", "Kxh7", "Rh3#" };
     h2.difficulty = PuzzleDifficulty::HARD;
-    h2.theme = "Queen Sacrifice";
+    h2.theme = "queenSacrifice";
     h2.description = "White to move";
-    h2.objective = "Win material advantage";
+    h2.objective = "Checkmate the King";
     h2.whiteToMove = true;
     hardPuzzles.push_back(h2);
 
     Puzzle h3;
     h3.id = 13;
-    h3.fen = "r1bq1rk1/ppp2ppp/2n5/3pPb2/1b1P4/2NB1N2/PPP2PPP/R1BQ1RK1 w - - 0 1";
-    h3.solution = { "Bxh7+", "Kxh7", "Ng5+", "Kg8", "Qh5" };
+    h3.fen = "4r1k1/pp3ppp/8/8/8/1Q6/PP2qPPP/3R2K1 b - - 0 1";
+    h3.solution = { "Qe1+", "Rxe1", "Rxe1#" };
     h3.difficulty = PuzzleDifficulty::HARD;
-    h3.theme = "Greek Gift";
-    h3.description = "White to move";
-    h3.objective = "Win the Queen";
-    h3.whiteToMove = true;
+    h3.theme = "deflection";
+    h3.description = "Black to move";
+    h3.objective = "Checkmate the King";
+    h3.whiteToMove = false;
     hardPuzzles.push_back(h3);
 
     Puzzle h4;
     h4.id = 14;
-    h4.fen = "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1";
-    h4.solution = { "Ra8+", "Kh7", "Ra7" };
+    h4.fen = "2kr3r/pp1nqppp/2n5/8/5B2/5Q2/PPP1BPPP/6K1 w - - 0 1";
+    h4.solution = { "Qxc6+", "bxc6", "Ba6#" };
     h4.difficulty = PuzzleDifficulty::HARD;
-    h4.theme = "Rook Endgame";
+    h4.theme = "bodensMate";
     h4.description = "White to move";
-    h4.objective = "Win all pawns";
+    h4.objective = "Checkmate the King";
     h4.whiteToMove = true;
     hardPuzzles.push_back(h4);
 
     Puzzle h5;
     h5.id = 15;
-    h5.fen = "8/8/4k3/4p3/4K3/8/8/8 w - - 0 1";
-    h5.solution = { "Kd3", "Kd5", "Ke3" };
+    h5.fen = "3q1r1k/pp2Nppp/8/3R4/8/3Q4/PPP2PPP/6K1 w - - 0 1";
+    h5.solution = { "Qxh7+", "Kxh7", "Rh5#" };
     h5.difficulty = PuzzleDifficulty::HARD;
-    h5.theme = "Opposition";
+    h5.theme = "anastasiasMate";
     h5.description = "White to move";
-    h5.objective = "Win the pawn";
+    h5.objective = "Checkmate the King";
     h5.whiteToMove = true;
     hardPuzzles.push_back(h5);
 
+
     // ==================== ULTRA HARD PUZZLES (5) ====================
 
     Puzzle u1;
     u1.id = 16;
-    u1.fen = "r1bqk2r/ppp2ppp/2n2n2/2bpp3/2B1P3/2PP1N2/PP3PPP/RNBQ1RK1 b kq - 0 1";
-    u1.solution = { "Nxe4", "dxe4", "Bxf2+", "Kxf2", "Qh4+", "g3", "Qxc4+" };
+    u1.fen = "6k1/5ppp/5r2/8/P3n3/1Q6/6PP/6K1 b - - 0 1";
+    u1.solution = { "Rf1+", "Kxf1", "Nd2+", "Ke2", "Nxb3" };
     u1.difficulty = PuzzleDifficulty::ULTRA_HARD;
-    u1.theme = "Complex Sacrifice";
+    u1.theme = "attraction";
     u1.description = "Black to move";
     u1.objective = "Win the Queen";
     u1.whiteToMove = false;
@@ -208,10 +235,10 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle u2;
     u2.id = 17;
-    u2.fen = "6rk/6pp/7P/8/8/8/8/5Q1K w - - 0 1";
-    u2.solution = { "Qf7", "Rg7", "Qf8+", "Rg8", "Qxg8#" };
+    u2.fen = "4kb1r/p2n1ppp/4q3/4p1B1/4P3/1Q6/PPP2PPP/2KR4 w k - 1 18";
+    u2.solution = { "Qb8+", "Nxb8", "Rd8#" };
     u2.difficulty = PuzzleDifficulty::ULTRA_HARD;
-    u2.theme = "Smothered Mate";
+    u2.theme = "queenSacrifice";
     u2.description = "White to move";
     u2.objective = "Checkmate the King";
     u2.whiteToMove = true;
@@ -219,10 +246,10 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle u3;
     u3.id = 18;
-    u3.fen = "r2q1rk1/ppp2ppp/2n5/3pPb2/1b1P4/2NB1N2/PPP1QPPP/R1B2RK1 w - - 0 1";
-    u3.solution = { "Bxh7+", "Kxh7", "Ng5+", "Kg6", "Qg4", "f5", "Qg3" };
+    u3.fen = "rn1qkbnr/ppp2p1p/3p2p1/4N3/2B1P3/2N5/PPPP1PPP/R1BbK2R w KQkq - 0 6";
+    u3.solution = { "Bxf7+", "Ke7", "Nd5#" };
     u3.difficulty = PuzzleDifficulty::ULTRA_HARD;
-    u3.theme = "Mating Attack";
+    u3.theme = "legalsMate";
     u3.description = "White to move";
     u3.objective = "Checkmate the King";
     u3.whiteToMove = true;
@@ -230,63 +257,721 @@ void ChessPuzzleSystem::initializePuzzles() {
 
     Puzzle u4;
     u4.id = 19;
-    u4.fen = "r1bq1rk1/ppp2ppp/2n5/3pPb2/1b1P4/2NB1N2/PPP2PPP/R1BQR1K1 w - - 0 1";
-    u4.solution = { "Bxh7+", "Kxh7", "Ng5+", "Kg8", "Qh5", "Re8", "Qxf7+", "Kh8", "Qh5+", "Kg8", "Qh7#" };
+    u4.fen = "6k1/6pp/1q6/p3N3/8/5R2/5PPP/6K1 w - - 0 1";
+    u4.solution = { "Rf8+", "Kxf8", "Nd7+", "Ke7", "Nxb6" };
     u4.difficulty = PuzzleDifficulty::ULTRA_HARD;
-    u4.theme = "Multiple Sacrifices";
+    u4.theme = "attraction";
     u4.description = "White to move";
-    u4.objective = "Checkmate the King";
+    u4.objective = "Win the Queen";
     u4.whiteToMove = true;
     ultraHardPuzzles.push_back(u4);
 
     Puzzle u5;
     u5.id = 20;
-    u5.fen = "8/8/8/4k3/4p3/4K3/4P3/8 w - - 0 1";
-    u5.solution = { "Kd3", "Kd5", "Ke3", "Ke5", "Kd3" };
+    u5.fen = "rr4k1/pp3p1p/5Pp1/8/8/8/PP1Q2PP/6K1 w - - 0 1";
+    u5.solution = { "Qh6", "Rc8", "Qg7#" };
     u5.difficulty = PuzzleDifficulty::ULTRA_HARD;
-    u5.theme = "King and Pawn Endgame";
+    u5.theme = "lollisMate";
     u5.description = "White to move";
-    u5.objective = "Win the game";
+    u5.objective = "Checkmate in two moves";
     u5.whiteToMove = true;
     ultraHardPuzzles.push_back(u5);
+
+    for (auto* tier : { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles })
+        for (Puzzle& p : *tier) p.rating = tierRating(p.difficulty);
+    compileCatalogue();
+    catalogueChanged();
 }
 
-Puzzle ChessPuzzleSystem::getNextPuzzle(PuzzleDifficulty difficulty) {
-    vector<Puzzle>* puzzleSet = nullptr;
+// ==================== PUZZLE CSV IMPORT ====================
+
+// Lichess export columns: PuzzleId,FEN,Moves,Rating,RatingDeviation,Popularity,NbPlays,
+// Themes,GameUrl,OpeningTags. The FEN is the position before the opponent's last move,
+// which is the first of Moves; the rest is the solution, in UCI.
+
+// Lichess ids are five base-62 characters; offset past the built-in ids 1-20
+static int puzzleIdFromLichess(std::string_view id) {
+    if (id.size() != 5) return -1;
+    int value = 0;
+    for (char c : id) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'z') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'Z') digit = c - 'A' + 36;
+        else return -1;
+        value = value * 62 + digit;
+    }
+    return value + 1000;        // at most 62^5 - 1 + 1000, well inside an int
+}
 
-    switch (difficulty) {
-    case PuzzleDifficulty::EASY:
-        puzzleSet = &easyPuzzles;
-        break;
-    case PuzzleDifficulty::INTERMEDIATE:
-        puzzleSet = &intermediatePuzzles;
-        break;
-    case PuzzleDifficulty::HARD:
-        puzzleSet = &hardPuzzles;
-        break;
-    case PuzzleDifficulty::ULTRA_HARD:
-        puzzleSet = &ultraHardPuzzles;
-        break;
+// Lowest rating of each tier for imported puzzles
+static const int TIER_MIN_RATING[4] = { 0, 1200, 1600, 2000 };
+
+static PuzzleDifficulty difficultyForRating(int rating) {
+    int d = 3;
+    while (d > 0 && rating < TIER_MIN_RATING[d]) d--;
+    return static_cast<PuzzleDifficulty>(d);
+}
+
+static string objectiveForThemes(std::string_view themes) {
+    size_t mate = themes.find("mateIn");
+    if (mate != std::string_view::npos && mate + 6 < themes.size()) return "Mate in " + string(1, themes[mate + 6]);
+    if (themes.find("mate") != std::string_view::npos) return "Checkmate";
+    return "Best move";
+}
+
+// Splits off the text up to the next comma (or the end)
+static std::string_view nextField(std::string_view& line) {
+    size_t comma = line.find(',');
+    std::string_view field = line.substr(0, comma);
+    line = comma == std::string_view::npos ? std::string_view() : line.substr(comma + 1);
+    return field;
+}
+
+static bool parsePuzzleRow(std::string_view line, Puzzle& p) {
+    std::string_view lichessId = nextField(line);
+    std::string_view fen = nextField(line);
+    std::string_view moves = nextField(line);
+    std::string_view rating = nextField(line);
+    nextField(line);    // RatingDeviation
+    nextField(line);    // Popularity
+    nextField(line);    // NbPlays
+    std::string_view themes = nextField(line);
+
+    p.id = puzzleIdFromLichess(lichessId);
+    if (p.id < 0) return false;
+
+    p.rating = 0;
+    for (char c : rating) {
+        if (c < '0' || c > '9') return false;
+        p.rating = p.rating * 10 + (c - '0');
+    }
+    if (rating.empty()) return false;
+
+    // Play the opponent's move so the stored position is the one the user solves
+    FenPosition pos;
+    if (parseFen(fen, pos) != nullptr) return false;
+    size_t space = moves.find(' ');
+    if (space == std::string_view::npos || !applyUciMove(pos, moves.substr(0, space))) return false;
+    p.fen = toFen(pos);
+    p.whiteToMove = pos.whiteToMove;
+
+    p.solution.clear();
+    for (std::string_view rest = moves.substr(space + 1); !rest.empty();) {
+        size_t next = rest.find(' ');
+        std::string_view uci = rest.substr(0, next);
+        if (uci.size() < 4 || uci.size() > 5) return false;
+        p.solution.emplace_back(uci);
+        rest = next == std::string_view::npos ? std::string_view() : rest.substr(next + 1);
+    }
+    p.uciSolution = true;
+
+    p.difficulty = difficultyForRating(p.rating);
+    p.theme = string(themes);
+    p.description = "Lichess " + string(lichessId);
+    p.objective = objectiveForThemes(themes);
+    return true;
+}
+
+// Replaces the catalogue with a Lichess puzzle CSV. The file is mapped and cut into one
+// chunk per thread at line breaks; each thread fills its own tier vectors, which are
+// moved into place at the end, so peak memory is the catalogue plus the mapped pages.
+bool ChessPuzzleSystem::loadPuzzlesCSV(const string& path, int threads) {
+    MappedFile file;
+    if (!file.open(path) || file.size() == 0) return false;
+    file.adviseSequential();
+
+    if (threads <= 0) threads = max(1u, std::thread::hardware_concurrency());
+    if (file.size() < ((size_t)1 << 20)) threads = 1;
+
+    const char* data = file.data();
+    const size_t size = file.size();
+    std::vector<size_t> starts(threads + 1, size);
+    starts[0] = 0;
+    for (int i = 1; i < threads; i++) {
+        size_t from = max(starts[i - 1], size / threads * i);
+        const char* nl = (const char*)memchr(data + from, '\n', size - from);
+        starts[i] = nl ? (size_t)(nl - data) + 1 : size;
     }
 
-    if (puzzleSet && !puzzleSet->empty()) {
-        vector<Puzzle> unsolved;
-        for (const auto& p : *puzzleSet) {
-            if (solvedPuzzles.find(p.id) == solvedPuzzles.end()) {
-                unsolved.push_back(p);
+    std::vector<std::vector<Puzzle>> tiers((size_t)threads * 4);
+    std::vector<size_t> rejected(threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::string_view chunk(data + starts[t], starts[t + 1] - starts[t]);
+            Puzzle p;
+            while (!chunk.empty()) {
+                size_t nl = chunk.find('\n');
+                std::string_view line = chunk.substr(0, nl);
+                chunk = nl == std::string_view::npos ? std::string_view() : chunk.substr(nl + 1);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.empty() || line.compare(0, 9, "PuzzleId,") == 0) continue;
+
+                if (parsePuzzleRow(line, p)) tiers[(size_t)t * 4 + (int)p.difficulty].push_back(std::move(p));
+                else rejected[t]++;
             }
+        });
+    }
+    for (std::thread& w : workers) w.join();
+
+    pack.close();
+    vector<Puzzle>* targets[4] = { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles };
+    size_t loaded = 0, bad = 0;
+    for (int d = 0; d < 4; d++) {
+        size_t total = 0;
+        for (int t = 0; t < threads; t++) total += tiers[(size_t)t * 4 + d].size();
+        targets[d]->clear();
+        targets[d]->shrink_to_fit();
+        targets[d]->reserve(total);
+        for (int t = 0; t < threads; t++) {
+            vector<Puzzle>& part = tiers[(size_t)t * 4 + d];
+            targets[d]->insert(targets[d]->end(), make_move_iterator(part.begin()), make_move_iterator(part.end()));
+            vector<Puzzle>().swap(part);
+        }
+        loaded += total;
+    }
+    for (size_t r : rejected) bad += r;
+    size_t unplayable = compileCatalogue();
+    loaded -= unplayable;
+    bad += unplayable;
+    catalogueChanged();
+
+    cout << "Loaded " << loaded << " puzzles from " << path;
+    if (bad) cout << " (" << bad << " malformed rows skipped)";
+    cout << endl;
+    return loaded > 0;
+}
+
+// ==================== SOLUTION LINES ====================
+
+bool ChessPuzzleSystem::compileLine(Puzzle& puzzle) const {
+    if (lineCompiler) return lineCompiler(puzzle.fen, puzzle.solution, puzzle.uciSolution, puzzle.moves);
+
+    // Without the engine only UCI can be encoded, and legality goes unchecked
+    puzzle.moves.clear();
+    if (!puzzle.uciSolution) return false;
+    for (const string& uci : puzzle.solution) {
+        uint16_t move = encodeUciMove(uci);
+        if (!move) return false;
+        puzzle.moves.push_back(move);
+    }
+    return !puzzle.moves.empty();
+}
+
+// Compiles every solution line in the vectors and drops the puzzles whose line does not
+// play; returns how many were dropped
+size_t ChessPuzzleSystem::compileCatalogue() {
+    size_t dropped = 0;
+    for (auto* tier : { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles }) {
+        auto kept = remove_if(tier->begin(), tier->end(), [&](Puzzle& p) {
+            if (compileLine(p)) return false;
+            cout << "Puzzle " << p.id << " rejected: solution line is illegal or ambiguous" << endl;
+            dropped++;
+            return true;
+        });
+        tier->erase(kept, tier->end());
+    }
+    return dropped;
+}
+
+// ==================== VERIFICATION ====================
+
+// Workers take the catalogue in small blocks off a shared counter, since search time varies
+// a lot from puzzle to puzzle. Verdicts go into one slot per puzzle, so nothing is locked.
+size_t ChessPuzzleSystem::verifyCatalogue(PuzzleVerifier verify, const string& reportPath, int threads) {
+    if (pack.isOpen()) {
+        cout << "Puzzle packs are verified when they are built" << endl;
+        return 0;
+    }
+    if (threads <= 0) threads = max(1u, std::thread::hardware_concurrency());
+
+    const size_t total = catalogueSize();
+    const size_t BLOCK = 64;
+    vector<string> reasons(total);          // empty when the puzzle is kept
+    std::atomic<size_t> next(0), done(0);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            size_t first;
+            while ((first = next.fetch_add(BLOCK)) < total) {
+                size_t last = min(first + BLOCK, total);
+                for (size_t i = first; i < last; i++) {
+                    string reason;
+                    if (!verify(vectorPuzzle(i), reason)) reasons[i] = reason.empty() ? "rejected" : reason;
+                }
+                done += last - first;
+            }
+        });
+    }
+
+    auto lastReport = start;
+    while (done < total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(30)) {
+            lastReport = now;
+            cout << "Verified " << done << " / " << total << " puzzles" << endl;
+        }
+    }
+    for (std::thread& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ofstream report(reportPath);
+    report << "PuzzleId,Rating,FEN,Reason\n";
+
+    size_t ordinal = 0, dropped = 0;
+    for (auto* tier : { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles }) {
+        size_t kept = 0;
+        for (size_t j = 0; j < tier->size(); j++, ordinal++) {
+            Puzzle& p = (*tier)[j];
+            if (!reasons[ordinal].empty()) {
+                report << p.id << ',' << p.rating << ',' << p.fen << ',' << reasons[ordinal] << '\n';
+                dropped++;
+                continue;
+            }
+            if (kept != j) (*tier)[kept] = std::move(p);
+            kept++;
+        }
+        tier->erase(tier->begin() + kept, tier->end());
+    }
+    catalogueChanged();
+
+    cout << "Verified " << total << " puzzles in " << seconds << " s (" << (size_t)(total / max(seconds, 1e-9))
+         << "/s): " << dropped << " rejected";
+    if (report) cout << ", listed in " << reportPath;
+    cout << endl;
+    return dropped;
+}
+
+// ==================== PUZZLE PACK ====================
+
+// Maps a pack built by savePuzzlePack. Records are sorted by rating, so the tiers are
+// found by binary search and nothing is read beyond the header and a few records.
+bool ChessPuzzleSystem::openPuzzlePack(const string& path) {
+    if (!pack.open(path)) return false;
+    if (pack.size() == 0) {
+        // Structurally fine, but nothing to play: let the caller fall back to CSV or built-ins
+        pack.close();
+        return false;
+    }
+
+    for (auto* tier : { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles })
+        vector<Puzzle>().swap(*tier);
+    catalogueChanged();
+
+    cout << "Opened puzzle pack " << path << " (" << pack.size() << " puzzles)" << endl;
+    return true;
+}
+
+// Writes the catalogue as a pack. Lines longer than PACK_MAX_MOVES are left out.
+bool ChessPuzzleSystem::savePuzzlePack(const string& path) const {
+    PuzzlePackWriter writer;
+    size_t skipped = 0, droppedTags = 0;
+
+    for (const vector<Puzzle>* tier : { &easyPuzzles, &intermediatePuzzles, &hardPuzzles, &ultraHardPuzzles }) {
+        for (const Puzzle& p : *tier) {
+            PuzzleRecord rec;
+            memset(&rec, 0, sizeof(rec));
+            FenPosition pos;
+            bool ok = !p.moves.empty() && p.moves.size() <= PACK_MAX_MOVES
+                && parseFen(p.fen, pos) == nullptr && packPosition(pos, rec);
+            if (!ok) {
+                skipped++;
+                continue;
+            }
+
+            rec.id = (uint32_t)p.id;
+            rec.rating = (uint16_t)min(max(p.rating, 0), 65535);
+            rec.moveCount = (uint8_t)p.moves.size();
+            copy(p.moves.begin(), p.moves.end(), rec.moves);
+            rec.description = writer.addText(p.description);
+
+            std::string_view themes = p.theme;
+            while (!themes.empty()) {
+                size_t space = themes.find(' ');
+                if (space != 0) {
+                    int bit = writer.themeBit(themes.substr(0, space));
+                    if (bit < 0) droppedTags++;
+                    else rec.themeMask[bit >> 6] |= 1ULL << (bit & 63);
+                }
+                themes = space == std::string_view::npos ? std::string_view() : themes.substr(space + 1);
+            }
+            writer.add(rec);
+        }
+    }
+
+    cout << "Packing " << writer.size() << " puzzles into " << path;
+    if (skipped) cout << " (" << skipped << " skipped)";
+    cout << endl;
+    if (droppedTags)
+        cout << droppedTags << " theme tags dropped: a pack holds at most " << PACK_MAX_THEMES << " distinct themes" << endl;
+    return writer.size() > 0 && writer.write(path);
+}
+
+Puzzle ChessPuzzleSystem::packPuzzle(size_t record) const {
+    const PuzzleRecord& rec = pack.record(record);
+    FenPosition pos;
+    unpackPosition(rec, pos);
+
+    Puzzle p;
+    p.id = (int)rec.id;
+    p.fen = toFen(pos);
+    p.whiteToMove = pos.whiteToMove;
+    p.rating = rec.rating;
+    p.difficulty = difficultyForRating(rec.rating);
+    p.moves.assign(rec.moves, rec.moves + min((int)rec.moveCount, PACK_MAX_MOVES));
+    for (uint16_t m : p.moves) p.solution.push_back(uciMoveText(m));
+    p.uciSolution = true;
+
+    for (int b = 0; b < pack.themeCount(); b++) {
+        if (!hasPackTheme(rec, b)) continue;
+        if (!p.theme.empty()) p.theme += ' ';
+        p.theme += pack.themeName(b);
+    }
+    p.description = pack.text(rec.description);
+    p.objective = objectiveForThemes(p.theme);
+    return p;
+}
+
+// ==================== CATALOGUE ACCESS ====================
+
+const vector<Puzzle>& ChessPuzzleSystem::tierPuzzles(PuzzleDifficulty difficulty) const {
+    switch (difficulty) {
+    case PuzzleDifficulty::INTERMEDIATE: return intermediatePuzzles;
+    case PuzzleDifficulty::HARD: return hardPuzzles;
+    case PuzzleDifficulty::ULTRA_HARD: return ultraHardPuzzles;
+    default: return easyPuzzles;
+    }
+}
+
+// Recomputes the tier ranges and drops the unsolved and theme indexes
+void ChessPuzzleSystem::catalogueChanged() {
+    tierStart[0] = 0;
+    for (int d = 0; d < 4; d++) {
+        if (pack.isOpen()) tierStart[d + 1] = d < 3 ? pack.lowerBound(TIER_MIN_RATING[d + 1]) : pack.size();
+        else tierStart[d + 1] = tierStart[d] + tierPuzzles(static_cast<PuzzleDifficulty>(d)).size();
+    }
+    invalidateUnsolved();
+
+    themeIndex.built = false;
+    themeIndex.names.clear();
+    themeIndex.ids.clear();
+    vector<vector<int>>().swap(themeIndex.postings);
+}
+
+const Puzzle& ChessPuzzleSystem::vectorPuzzle(size_t ordinal) const {
+    int d = 0;
+    while (d < 3 && ordinal >= tierStart[d + 1]) d++;
+    return tierPuzzles(static_cast<PuzzleDifficulty>(d))[ordinal - tierStart[d]];
+}
+
+int ChessPuzzleSystem::idAt(size_t ordinal) const {
+    return pack.isOpen() ? (int)pack.record(ordinal).id : vectorPuzzle(ordinal).id;
+}
+
+int ChessPuzzleSystem::ratingAt(size_t ordinal) const {
+    return pack.isOpen() ? pack.record(ordinal).rating : vectorPuzzle(ordinal).rating;
+}
+
+Puzzle ChessPuzzleSystem::puzzleAt(size_t ordinal) const {
+    Puzzle p = pack.isOpen() ? packPuzzle(ordinal) : vectorPuzzle(ordinal);
+    p.catalogIndex = (int)ordinal;
+    return p;
+}
+
+// ==================== UNSOLVED INDEX ====================
+
+static int ratingSlot(int rating, int slots) {
+    return min(max(rating, 0), slots - 1);
+}
+
+static void fenwickAdd(vector<int>& tree, int slot, int delta) {
+    for (int i = slot + 1; i < (int)tree.size(); i += i & -i) tree[i] += delta;
+}
+
+// Puzzles in slots 0..slot
+static int fenwickPrefix(const vector<int>& tree, int slot) {
+    int n = 0;
+    for (int i = slot + 1; i > 0; i -= i & -i) n += tree[i];
+    return n;
+}
+
+// Slot holding the k-th puzzle (0-based) in slot order
+static int fenwickFind(const vector<int>& tree, int k) {
+    int pos = 0;
+    int step = 1;
+    while (step * 2 < (int)tree.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step < (int)tree.size() && tree[pos + step] <= k) {
+            pos += step;
+            k -= tree[pos];
         }
+    }
+    return pos;
+}
+
+ChessPuzzleSystem::RatingIndex& ChessPuzzleSystem::unsolvedIndex() {
+    RatingIndex& index = unsolved;
+    if (index.built) return index;
+
+    size_t count = catalogueSize();
+    index.byRating.assign(RATING_SLOTS, vector<int>());
+    index.slotOf.assign(count, -1);
+    for (size_t g = 0; g < count; g++) {
+        if (solvedPuzzles.contains(idAt(g))) continue;
+        vector<int>& list = index.byRating[ratingSlot(ratingAt(g), RATING_SLOTS)];
+        index.slotOf[g] = (int)list.size();
+        list.push_back((int)g);
+    }
+
+    // Linear Fenwick construction: each node passes its sum up to its parent
+    index.tree.assign(RATING_SLOTS + 1, 0);
+    for (int i = 1; i <= RATING_SLOTS; i++) {
+        index.tree[i] += (int)index.byRating[i - 1].size();
+        int parent = i + (i & -i);
+        if (parent <= RATING_SLOTS) index.tree[parent] += index.tree[i];
+    }
+    index.built = true;
+    return index;
+}
 
-        if (unsolved.empty()) {
-            int idx = rand() % puzzleSet->size();
-            return (*puzzleSet)[idx];
+int ChessPuzzleSystem::countUnsolved(int minRating, int maxRating) {
+    int lo = ratingSlot(minRating, RATING_SLOTS), hi = ratingSlot(maxRating, RATING_SLOTS);
+    if (lo > hi) return 0;
+    const vector<int>& tree = unsolvedIndex().tree;
+    return fenwickPrefix(tree, hi) - (lo > 0 ? fenwickPrefix(tree, lo - 1) : 0);
+}
+
+// Ordinal of a uniformly random unsolved puzzle rated minRating..maxRating, or -1
+int ChessPuzzleSystem::pickUnsolved(int minRating, int maxRating) {
+    int lo = ratingSlot(minRating, RATING_SLOTS), hi = ratingSlot(maxRating, RATING_SLOTS);
+    if (lo > hi) return -1;
+    RatingIndex& index = unsolvedIndex();
+
+    int before = lo > 0 ? fenwickPrefix(index.tree, lo - 1) : 0;
+    int inRange = fenwickPrefix(index.tree, hi) - before;
+    if (inRange == 0) return -1;
+
+    int k = before + uniform_int_distribution<int>(0, inRange - 1)(rng);
+    int slot = fenwickFind(index.tree, k);
+    int offset = k - (slot > 0 ? fenwickPrefix(index.tree, slot - 1) : 0);
+    return index.byRating[slot][offset];
+}
+
+void ChessPuzzleSystem::markSolved(const Puzzle& puzzle) {
+    RatingIndex& index = unsolved;
+    int g = puzzle.catalogIndex;
+    if (!index.built || g < 0 || g >= (int)index.slotOf.size() || index.slotOf[g] < 0) return;
+
+    int slot = ratingSlot(ratingAt(g), RATING_SLOTS);
+    vector<int>& list = index.byRating[slot];
+    int pos = index.slotOf[g];
+    int last = list.back();
+    list[pos] = last;
+    index.slotOf[last] = pos;
+    list.pop_back();
+    index.slotOf[g] = -1;
+    fenwickAdd(index.tree, slot, -1);
+}
+
+// The catalogue or the solved set changed wholesale
+void ChessPuzzleSystem::invalidateUnsolved() {
+    unsolved.built = false;
+    vector<vector<int>>().swap(unsolved.byRating);
+    vector<int>().swap(unsolved.slotOf);
+    vector<int>().swap(unsolved.tree);
+}
+
+// Highest rating of a tier; ratings past the index's top slot all count as Ultra Hard
+static int tierMaxRating(int d) {
+    return d < 3 ? TIER_MIN_RATING[d + 1] - 1 : INT_MAX;
+}
+
+void ChessPuzzleSystem::tierRatingRange(PuzzleDifficulty difficulty, int& minRating, int& maxRating) {
+    minRating = TIER_MIN_RATING[(int)difficulty];
+    maxRating = tierMaxRating((int)difficulty);
+}
+
+Puzzle ChessPuzzleSystem::getNextPuzzle(PuzzleDifficulty difficulty) {
+    int d = (int)difficulty;
+    int count = tierSize(difficulty);
+    if (count > 0) {
+        int ordinal = pickUnsolved(TIER_MIN_RATING[d], tierMaxRating(d));
+
+        // Everything solved: any puzzle of the tier again
+        if (ordinal < 0) ordinal = (int)tierStart[d] + uniform_int_distribution<int>(0, count - 1)(rng);
+
+        return puzzleAt(ordinal);
+    }
+
+    // Nothing in this tier: the closest-rated puzzle from the others
+    if (catalogueSize() > 0) return getPuzzleNearRating(tierRating(difficulty));
+
+    // No catalogue at all: the built-in puzzles are always there to fall back on
+    initializePuzzles();
+    return getNextPuzzle(difficulty);
+}
+
+// Widens the window (doubling, at least 50 points) until an unsolved puzzle turns up
+Puzzle ChessPuzzleSystem::getPuzzleNearRating(int rating, int window) {
+    size_t count = catalogueSize();
+    if (count == 0) return getNextPuzzle(PuzzleDifficulty::EASY);
+
+    for (int w = max(window, 0);; w = max(w * 2, 50)) {
+        int ordinal = pickUnsolved(rating - w, rating + w);
+        if (ordinal >= 0) return puzzleAt(ordinal);
+        if (rating - w <= 0 && rating + w >= RATING_SLOTS - 1) break;
+    }
+    return puzzleAt(uniform_int_distribution<size_t>(0, count - 1)(rng));
+}
+
+// ==================== THEME INDEX ====================
+
+ChessPuzzleSystem::ThemeIndex& ChessPuzzleSystem::themes() {
+    ThemeIndex& index = themeIndex;
+    if (index.built) return index;
+
+    size_t count = catalogueSize();
+    if (pack.isOpen()) {
+        // Records are already in rating order, so the lists come out sorted
+        for (int b = 0; b < pack.themeCount(); b++) {
+            index.ids.emplace(pack.themeName(b), b);
+            index.names.push_back(pack.themeName(b));
         }
+        index.postings.assign(index.names.size(), vector<int>());
+        for (size_t g = 0; g < count; g++) {
+            const PuzzleRecord& rec = pack.record(g);
+            for (int w = 0; w < PACK_MAX_THEMES / 64; w++) {
+                for (uint64_t m = rec.themeMask[w]; m; m &= m - 1) {
+                    int b = w * 64;
+                    while (!(m >> (b & 63) & 1)) b++;
+                    if (b < (int)index.postings.size()) index.postings[b].push_back((int)g);
+                }
+            }
+        }
+    }
+    else {
+        for (size_t g = 0; g < count; g++) {
+            std::string_view tags = vectorPuzzle(g).theme;
+            while (!tags.empty()) {
+                size_t space = tags.find(' ');
+                std::string_view tag = tags.substr(0, space);
+                tags = space == std::string_view::npos ? std::string_view() : tags.substr(space + 1);
+                if (tag.empty()) continue;
+
+                auto it = index.ids.find(string(tag));
+                if (it == index.ids.end()) {
+                    it = index.ids.emplace(string(tag), (int)index.names.size()).first;
+                    index.names.emplace_back(tag);
+                    index.postings.emplace_back();
+                }
+                vector<int>& list = index.postings[it->second];
+                if (list.empty() || list.back() != (int)g) list.push_back((int)g);
+            }
+        }
+        vector<int> rating(count);
+        for (size_t g = 0; g < count; g++) rating[g] = vectorPuzzle(g).rating;
+        for (vector<int>& list : index.postings)
+            stable_sort(list.begin(), list.end(), [&](int a, int b) { return rating[a] < rating[b]; });
+    }
+    index.built = true;
+    return index;
+}
+
+bool ChessPuzzleSystem::hasTheme(int ordinal, int theme) {
+    if (pack.isOpen()) return hasPackTheme(pack.record(ordinal), theme);
+
+    // Lists are sorted by rating, then ordinal
+    const vector<int>& list = themes().postings[theme];
+    int rating = ratingAt(ordinal);
+    auto it = lower_bound(list.begin(), list.end(), ordinal, [&](int g, int target) {
+        int r = ratingAt(g);
+        return r < rating || (r == rating && g < target);
+    });
+    return it != list.end() && *it == ordinal;
+}
+
+int ChessPuzzleSystem::getThemeId(const string& name) {
+    ThemeIndex& index = themes();
+    auto it = index.ids.find(name);
+    return it == index.ids.end() ? -1 : it->second;
+}
+
+const vector<string>& ChessPuzzleSystem::getThemeNames() {
+    return themes().names;
+}
+
+// Walks the rarest theme's list, cut to the rating window by binary search. Random probes
+// find a match in a few tries unless matches are rare, in which case the window is
+// scanned; either way the pick is uniform over the puzzles that pass every filter.
+bool ChessPuzzleSystem::findThemedPuzzle(const vector<int>& themeIds, int minRating, int maxRating, Puzzle& out) {
+    if (themeIds.empty()) {
+        int ordinal = pickUnsolved(minRating, maxRating);
+        if (ordinal < 0) return false;
+        out = puzzleAt(ordinal);
+        return true;
+    }
+
+    ThemeIndex& index = themes();
+    int rarest = -1;
+    for (int t : themeIds) {
+        if (t < 0 || t >= (int)index.postings.size()) return false;
+        if (rarest < 0 || index.postings[t].size() < index.postings[rarest].size()) rarest = t;
+    }
 
-        int idx = rand() % unsolved.size();
-        return unsolved[idx];
+    const vector<int>& list = index.postings[rarest];
+    size_t first = lower_bound(list.begin(), list.end(), minRating,
+        [&](int g, int rating) { return ratingAt(g) < rating; }) - list.begin();
+    size_t last = upper_bound(list.begin(), list.end(), maxRating,
+        [&](int rating, int g) { return rating < ratingAt(g); }) - list.begin();
+    if (first >= last) return false;
+
+    const vector<int>& slotOf = unsolvedIndex().slotOf;
+    auto matches = [&](int g) {
+        if (slotOf[g] < 0) return false;
+        for (int t : themeIds)
+            if (t != rarest && !hasTheme(g, t)) return false;
+        return true;
+    };
+
+    uniform_int_distribution<size_t> position(first, last - 1);
+    for (int tries = 0; tries < 32; tries++) {
+        int g = list[position(rng)];
+        if (matches(g)) {
+            out = puzzleAt(g);
+            return true;
+        }
     }
 
-    return easyPuzzles[0];
+    vector<int> hits;
+    for (size_t i = first; i < last; i++)
+        if (matches(list[i])) hits.push_back(list[i]);
+    if (hits.empty()) return false;
+    out = puzzleAt(hits[uniform_int_distribution<size_t>(0, hits.size() - 1)(rng)]);
+    return true;
+}
+
+// "backRankMate mateIn2" -> "Back Rank Mate, Mate In 2"
+string ChessPuzzleSystem::themeLabel(const string& tags) {
+    string label;
+    bool wordStart = true;
+    for (size_t i = 0; i < tags.size(); i++) {
+        char c = tags[i];
+        if (c == ' ') {
+            if (!label.empty() && label.back() != ' ') label += ", ";
+            wordStart = true;
+            continue;
+        }
+        bool digitRun = isdigit((unsigned char)c) && i > 0 && !isdigit((unsigned char)tags[i - 1]);
+        if (!wordStart && (isupper((unsigned char)c) || digitRun)) label += ' ';
+        label += wordStart ? (char)toupper((unsigned char)c) : c;
+        wordStart = false;
+    }
+    while (!label.empty() && (label.back() == ' ' || label.back() == ',')) label.pop_back();
+    return label;
 }
 
 Puzzle ChessPuzzleSystem::getCurrentPuzzleByDifficulty(PuzzleDifficulty difficulty) {
@@ -303,7 +988,7 @@ void ChessPuzzleSystem::startPuzzle(const Puzzle& puzzle) {
     hintsUsed = 0;
 }
 
-PuzzleResult ChessPuzzleSystem::checkMove(const string& move) {
+PuzzleResult ChessPuzzleSystem::checkMove(uint16_t move) {
     PuzzleResult result;
     result.correct = false;
     result.isComplete = false;
@@ -313,13 +998,19 @@ PuzzleResult ChessPuzzleSystem::checkMove(const string& move) {
         return result;
     }
 
-    string expectedMove = currentPuzzle->solution[moveIndex];
-    bool isCorrect = (normalizeSAN(move) == normalizeSAN(expectedMove));
+    bool isCorrect = moveIndex < (int)currentPuzzle->moves.size() && move == currentPuzzle->moves[moveIndex];
+
+    // Another mate, or another move winning as much, solves the puzzle too
+    if (!isCorrect && alternativeJudge && moveIndex < (int)currentPuzzle->moves.size()
+        && alternativeJudge(*currentPuzzle, moveIndex, move)) {
+        return completePuzzle(true);
+    }
 
     if (isCorrect) {
-        moveIndex++;
+        // The player's move and the opponent's scripted reply after it
+        moveIndex = min(moveIndex + 2, (int)currentPuzzle->moves.size());
 
-        if (moveIndex >= (int)currentPuzzle->solution.size()) {
+        if (moveIndex >= (int)currentPuzzle->moves.size()) {
             return completePuzzle(true);
         }
 
@@ -348,13 +1039,7 @@ PuzzleResult ChessPuzzleSystem::completePuzzle(bool solved) {
     time_t endTime = time(0);
     int timeTaken = (int)difftime(endTime, puzzleStartTime);
 
-    int puzzleDifficultyRating = 800;
-    switch (currentPuzzle->difficulty) {
-    case PuzzleDifficulty::EASY: puzzleDifficultyRating = 800; break;
-    case PuzzleDifficulty::INTERMEDIATE: puzzleDifficultyRating = 1200; break;
-    case PuzzleDifficulty::HARD: puzzleDifficultyRating = 1600; break;
-    case PuzzleDifficulty::ULTRA_HARD: puzzleDifficultyRating = 2000; break;
-    }
+    int puzzleDifficultyRating = currentPuzzle->rating > 0 ? currentPuzzle->rating : tierRating(currentPuzzle->difficulty);
 
     int ratingChange = 0;
     int bonusPoints = 0;
@@ -380,7 +1065,7 @@ PuzzleResult ChessPuzzleSystem::completePuzzle(bool solved) {
         }
         lastSolvedDate = today;
 
-        solvedPuzzles.insert(currentPuzzle->id);
+        if (solvedPuzzles.add(currentPuzzle->id)) markSolved(*currentPuzzle);
         result.message = "Puzzle solved!";
     }
     else {
@@ -424,7 +1109,7 @@ string ChessPuzzleSystem::getHint() {
     string hint;
     switch (hintsUsed) {
     case 1:
-        hint = "Theme: " + currentPuzzle->theme;
+        hint = "Theme: " + themeLabel(currentPuzzle->theme);
         break;
     case 2:
         hint = "Move your " + getPieceFromMove(currentMove);
@@ -485,6 +1170,7 @@ bool ChessPuzzleSystem::isConsecutiveDay(time_t lastDate) {
 void ChessPuzzleSystem::resetProgress() {
     userRating = 1200;
     solvedPuzzles.clear();
+    invalidateUnsolved();
     streakCount = 0;
     lastSolvedDate = 0;
     if (currentPuzzle) {
@@ -493,16 +1179,16 @@ void ChessPuzzleSystem::resetProgress() {
     }
 }
 
+// Rating, streak and last solve date, then the solved ids as a RoaringBitmap after a
+// "roaring" marker. Older files have a count and a plain id list there instead.
 void ChessPuzzleSystem::saveProgress() {
     ofstream file("puzzle_progress.dat");
     if (file.is_open()) {
         file << userRating << endl;
         file << streakCount << endl;
         file << lastSolvedDate << endl;
-        file << solvedPuzzles.size() << endl;
-        for (int id : solvedPuzzles) {
-            file << id << " ";
-        }
+        file << "roaring ";
+        solvedPuzzles.write(file);
         file.close();
     }
 }
@@ -514,21 +1200,27 @@ void ChessPuzzleSystem::loadProgress() {
         file >> streakCount;
         file >> lastSolvedDate;
 
-        int count;
-        file >> count;
+        string format;
+        file >> format;
         solvedPuzzles.clear();
-        for (int i = 0; i < count; i++) {
-            int id;
-            file >> id;
-            solvedPuzzles.insert(id);
+        if (format == "roaring") {
+            if (!solvedPuzzles.read(file)) solvedPuzzles.clear();
+        }
+        else {
+            int count = atoi(format.c_str());
+            for (int i = 0; i < count; i++) {
+                int id;
+                if (!(file >> id)) break;
+                solvedPuzzles.add(id);
+            }
         }
         file.close();
+        invalidateUnsolved();
     }
 }
 
 int ChessPuzzleSystem::getTotalPuzzles() const {
-    return (int)(easyPuzzles.size() + intermediatePuzzles.size() +
-        hardPuzzles.size() + ultraHardPuzzles.size());
+    return (int)catalogueSize();
 }
 
 int ChessPuzzleSystem::getElapsedTime() const {
@@ -538,31 +1230,10 @@ int ChessPuzzleSystem::getElapsedTime() const {
 }
 
 int ChessPuzzleSystem::getPuzzleCount(PuzzleDifficulty difficulty) const {
-    switch (difficulty) {
-    case PuzzleDifficulty::EASY: return (int)easyPuzzles.size();
-    case PuzzleDifficulty::INTERMEDIATE: return (int)intermediatePuzzles.size();
-    case PuzzleDifficulty::HARD: return (int)hardPuzzles.size();
-    case PuzzleDifficulty::ULTRA_HARD: return (int)ultraHardPuzzles.size();
-    default: return 0;
-    }
+    return tierSize(difficulty);
 }
 
-int ChessPuzzleSystem::getSolvedCountByDifficulty(PuzzleDifficulty difficulty) const {
-    const vector<Puzzle>* puzzleSet = nullptr;
-    switch (difficulty) {
-    case PuzzleDifficulty::EASY: puzzleSet = &easyPuzzles; break;
-    case PuzzleDifficulty::INTERMEDIATE: puzzleSet = &intermediatePuzzles; break;
-    case PuzzleDifficulty::HARD: puzzleSet = &hardPuzzles; break;
-    case PuzzleDifficulty::ULTRA_HARD: puzzleSet = &ultraHardPuzzles; break;
-    }
-
-    if (!puzzleSet) return 0;
-
-    int count = 0;
-    for (const auto& p : *puzzleSet) {
-        if (solvedPuzzles.find(p.id) != solvedPuzzles.end()) {
-            count++;
-        }
-    }
-    return count;
-}
\ No newline at end of file
+int ChessPuzzleSystem::getSolvedCountByDifficulty(PuzzleDifficulty difficulty) {
+    int d = (int)difficulty;
+    return tierSize(difficulty) - countUnsolved(TIER_MIN_RATING[d], tierMaxRating(d));
+}
@@ -7,6 +7,10 @@
 #include <ctime>
 #include <cmath>
 #include <algorithm>
+#include <random>
+#include <unordered_map>
+#include "PuzzlePack.h"
+#include "RoaringBitmap.h"
 
 using namespace std;
 
@@ -23,12 +27,29 @@ struct Puzzle {
     string fen;
     vector<string> solution;
     PuzzleDifficulty difficulty;
-    string theme;
+    string theme;               // space-separated tags, e.g. "fork middlegame short"
     string description;
     string objective;
     bool whiteToMove;
+    int rating = 0;             // Elo-style difficulty; imported puzzles bring their own
+    bool uciSolution = false;   // solution written as "e2e4" moves (imported), not SAN
+    vector<uint16_t> moves;     // the solution as packMove values, compiled and checked at load
+    int catalogIndex = -1;      // catalogue ordinal, set when taken from the catalogue
 };
 
+// Plays 'line' (SAN, or UCI when 'uci') from 'fen' and encodes every move with packMove.
+// Fails on the first move that is malformed, illegal or ambiguous. The game supplies it,
+// since the rules live in the engine.
+typedef bool (*LineCompiler)(const string& fen, const vector<string>& line, bool uci, vector<uint16_t>& moves);
+
+// Judges a puzzle with the engine: false, with a short reason, if it should be dropped.
+// Runs on several threads at once, so it may only touch per-thread state.
+typedef bool (*PuzzleVerifier)(const Puzzle& puzzle, string& reason);
+
+// Asked by checkMove when 'move' (packMove form) differs from the solution at 'ply': true
+// if it wins just as well and should count. Must answer within a frame.
+typedef bool (*AlternativeJudge)(const Puzzle& puzzle, int ply, uint16_t move);
+
 struct PuzzleResult {
     bool correct;
     bool isComplete;
@@ -51,9 +72,40 @@ private:
     vector<Puzzle> hardPuzzles;
     vector<Puzzle> ultraHardPuzzles;
 
+    PuzzlePack pack;
+
+    // Every puzzle has a catalogue ordinal: tier d holds [tierStart[d], tierStart[d + 1]).
+    // With a pack open, which replaces the vectors, it is the record number (records are
+    // sorted by rating); otherwise it runs through the four vectors in order.
+    size_t tierStart[5];
+
+    // Unsolved puzzles by exact rating (0..RATING_SLOTS - 1, higher ratings share the top
+    // slot). Each rating has a swap-remove list of ordinals, and a Fenwick tree over the list
+    // sizes counts and selects across any rating window in O(log RATING_SLOTS). Built on
+    // first use, so opening a pack stays instant.
+    static const int RATING_SLOTS = 4096;
+    struct RatingIndex {
+        bool built = false;
+        vector<vector<int>> byRating;
+        vector<int> slotOf;     // per ordinal: position in its rating's list, -1 once solved
+        vector<int> tree;       // Fenwick tree, RATING_SLOTS + 1 entries
+    };
+    RatingIndex unsolved;
+
+    // Theme tags interned to ids; postings[id] holds the ordinals of the puzzles carrying
+    // that tag, ordered by rating. With a pack the ids are its theme bits. Built on first use.
+    struct ThemeIndex {
+        bool built = false;
+        vector<string> names;
+        unordered_map<string, int> ids;
+        vector<vector<int>> postings;
+    };
+    ThemeIndex themeIndex;
+    mt19937 rng;
+
     Puzzle* currentPuzzle;
     int userRating;
-    set<int> solvedPuzzles;
+    RoaringBitmap solvedPuzzles;
     int streakCount;
     time_t lastSolvedDate;
 
@@ -65,23 +117,67 @@ private:
     PuzzleDifficulty currentDifficulty;
     int currentIndexInDifficulty;
 
+    LineCompiler lineCompiler;
+    AlternativeJudge alternativeJudge;
+
+    const vector<Puzzle>& tierPuzzles(PuzzleDifficulty difficulty) const;
+    int tierSize(PuzzleDifficulty difficulty) const { return (int)(tierStart[(int)difficulty + 1] - tierStart[(int)difficulty]); }
+    size_t catalogueSize() const { return tierStart[4]; }
+    const Puzzle& vectorPuzzle(size_t ordinal) const;
+    int idAt(size_t ordinal) const;
+    int ratingAt(size_t ordinal) const;
+    Puzzle puzzleAt(size_t ordinal) const;
+    Puzzle packPuzzle(size_t record) const;
+    void catalogueChanged();
+    bool compileLine(Puzzle& puzzle) const;
+    size_t compileCatalogue();
+
+    RatingIndex& unsolvedIndex();
+    int countUnsolved(int minRating, int maxRating);
+    int pickUnsolved(int minRating, int maxRating);
+    void markSolved(const Puzzle& puzzle);
+    void invalidateUnsolved();
+
+    ThemeIndex& themes();
+    bool hasTheme(int ordinal, int theme);
+
 public:
     ChessPuzzleSystem();
     ~ChessPuzzleSystem();
 
+    void setLineCompiler(LineCompiler compiler) { lineCompiler = compiler; }
+    void setAlternativeJudge(AlternativeJudge judge) { alternativeJudge = judge; }
     void initializePuzzles();
+    bool loadPuzzlesCSV(const string& path, int threads = 0);
+    bool openPuzzlePack(const string& path);
+    bool savePuzzlePack(const string& path) const;
+    // Runs 'verify' over the loaded catalogue on a thread pool (0 = all cores), drops what it
+    // rejects and lists those in a CSV report. Returns how many were dropped.
+    size_t verifyCatalogue(PuzzleVerifier verify, const string& reportPath, int threads = 0);
     Puzzle getNextPuzzle(PuzzleDifficulty difficulty);
+    Puzzle getPuzzleNearRating(int rating, int window = 100);
+    // Ratings an imported puzzle needs to land in a tier
+    static void tierRatingRange(PuzzleDifficulty difficulty, int& minRating, int& maxRating);
+
+    // Theme tag -> id (-1 if no puzzle has it), and a random unsolved puzzle carrying every
+    // listed theme and rated minRating..maxRating
+    int getThemeId(const string& name);
+    const vector<string>& getThemeNames();
+    bool findThemedPuzzle(const vector<int>& themeIds, int minRating, int maxRating, Puzzle& out);
+    static string themeLabel(const string& tags);
     Puzzle getCurrentPuzzleByDifficulty(PuzzleDifficulty difficulty);
     void startPuzzle(const Puzzle& puzzle);
-    PuzzleResult checkMove(const string& move);
+    PuzzleResult checkMove(uint16_t move);
     string getHint();
 
     int getRating() const { return userRating; }
-    int getSolvedCount() const { return (int)solvedPuzzles.size(); }
+    int getSolvedCount() const { return (int)solvedPuzzles.cardinality(); }
     int getStreak() const { return streakCount; }
     int getTotalPuzzles() const;
     int getElapsedTime() const;
     int getRemainingAttempts() const { return 3 - attempts; }
+    // Solution plies already on the board, opponent replies included
+    int getPly() const { return moveIndex; }
 
     string normalizeSAN(const string& move);
     string getPieceFromMove(const string& move);
@@ -97,7 +193,7 @@ public:
     Puzzle* getCurrentPuzzle() { return currentPuzzle; }
 
     int getPuzzleCount(PuzzleDifficulty difficulty) const;
-    int getSolvedCountByDifficulty(PuzzleDifficulty difficulty) const;
+    int getSolvedCountByDifficulty(PuzzleDifficulty difficulty);
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "FenParser.h"
+#include <cstring>
+
+// What each byte means in the piece placement field. Letters place a piece and advance
+// one square, digits advance that many, '/' starts the next rank; anything else is bad.
+struct FenChar {
+    uint8_t piece = EMPTY;
+    uint8_t advance = 0;
+    uint8_t slash = 0;
+    uint8_t bad = 0;
+    uint8_t whiteKing = 0, blackKing = 0;
+};
+
+struct FenCharTable {
+    FenChar ch[256];
+    constexpr FenCharTable() : ch() {
+        const char* letters = " PRNBQK  prnbqk ";
+        for (int i = 0; i < 256; i++) ch[i].bad = 1;
+        for (int code = 0; code < 16; code++) {
+            if (letters[code] == ' ') continue;
+            FenChar& e = ch[(uint8_t)letters[code]];
+            e.piece = (uint8_t)code;
+            e.advance = 1;
+            e.bad = 0;
+            e.whiteKing = code == W_KING;
+            e.blackKing = code == B_KING;
+        }
+        for (int d = 1; d <= 8; d++) {
+            ch['0' + d].advance = (uint8_t)d;
+            ch['0' + d].bad = 0;
+        }
+        ch[(uint8_t)'/'].slash = 1;
+        ch[(uint8_t)'/'].bad = 0;
+    }
+};
+static constexpr FenCharTable FEN_CHARS;
+
+// Unsigned decimal of at most five digits
+static bool readCounter(std::string_view s, size_t& i, int& value) {
+    size_t start = i;
+    value = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        if (i - start == 5) return false;
+        value = value * 10 + (s[i] - '0');
+        i++;
+    }
+    return i > start && value <= 65535;
+}
+
+static char* writeCounter(char* p, int value) {
+    char digits[5];
+    int n = 0;
+    value = value < 0 ? 0 : (value > 65535 ? 65535 : value);
+    do { digits[n++] = char('0' + value % 10); value /= 10; } while (value);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+const char* parseFen(std::string_view fen, FenPosition& pos) {
+    // Line ends and trailing blanks from files are not part of the record
+    while (!fen.empty() && (fen.back() == ' ' || fen.back() == '\t' || fen.back() == '\r' || fen.back() == '\n'))
+        fen.remove_suffix(1);
+
+    const size_t n = fen.size();
+    size_t i = 0;
+
+    // ---------- Piece placement, rank 8 first ----------
+    // No branch per character: every byte writes its piece (EMPTY for digits and '/')
+    // at the current square and the checks are folded into flags tested once at the end.
+    Piece squares[65];
+    memset(squares, EMPTY, sizeof(squares));
+    int total = 0, ranks = 0;
+    int bad = 0, misplacedSlash = 0, whiteKings = 0, blackKings = 0;
+    for (; i < n && fen[i] != ' '; i++) {
+        const FenChar& e = FEN_CHARS.ch[(uint8_t)fen[i]];
+        squares[total < 64 ? total : 64] = e.piece;
+        misplacedSlash |= e.slash & (total != (ranks + 1) * 8);
+        ranks += e.slash;
+        total += e.advance;
+        bad |= e.bad;
+        whiteKings += e.whiteKing;
+        blackKings += e.blackKing;
+    }
+    if (bad) return "unknown character in piece placement";
+    if (misplacedSlash || ranks != 7 || total != 64) return "board is not 8 ranks of 8 squares";
+    if (whiteKings != 1 || blackKings != 1) return "each side needs exactly one king";
+    for (int c = 0; c < 8; c++)
+        if (pieceType(squares[c]) == PAWN || pieceType(squares[56 + c]) == PAWN)
+            return "pawn on the first or last rank";
+    memcpy(pos.board, squares, sizeof(pos.board));
+
+    // ---------- Side to move ----------
+    if (i + 2 > n || fen[i] != ' ') return "missing side to move";
+    if (fen[i + 1] == 'w') pos.whiteToMove = true;
+    else if (fen[i + 1] == 'b') pos.whiteToMove = false;
+    else return "side to move is not 'w' or 'b'";
+    i += 2;
+
+    // ---------- Castling rights ----------
+    if (i + 2 > n || fen[i] != ' ') return "missing castling rights";
+    i++;
+    pos.castling = 0;
+    if (fen[i] == '-') i++;
+    else if (fen[i] == ' ') return "missing castling rights";
+    else {
+        for (; i < n && fen[i] != ' '; i++) {
+            uint8_t right;
+            switch (fen[i]) {
+            case 'K': right = CASTLE_WHITE_KING; break;
+            case 'Q': right = CASTLE_WHITE_QUEEN; break;
+            case 'k': right = CASTLE_BLACK_KING; break;
+            case 'q': right = CASTLE_BLACK_QUEEN; break;
+            default: return "unknown castling letter";
+            }
+            if (pos.castling & right) return "castling right repeated";
+            pos.castling |= right;
+        }
+    }
+    const Piece(&b)[8][8] = pos.board;
+    if ((pos.castling & (CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN)) && b[7][4] != W_KING) return "castling right without king on e1";
+    if ((pos.castling & (CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN)) && b[0][4] != B_KING) return "castling right without king on e8";
+    if ((pos.castling & CASTLE_WHITE_KING) && b[7][7] != W_ROOK) return "castling right without rook on h1";
+    if ((pos.castling & CASTLE_WHITE_QUEEN) && b[7][0] != W_ROOK) return "castling right without rook on a1";
+    if ((pos.castling & CASTLE_BLACK_KING) && b[0][7] != B_ROOK) return "castling right without rook on h8";
+    if ((pos.castling & CASTLE_BLACK_QUEEN) && b[0][0] != B_ROOK) return "castling right without rook on a8";
+
+    // ---------- En passant target ----------
+    if (i + 2 > n || fen[i] != ' ') return "missing en passant square";
+    i++;
+    pos.epRow = pos.epCol = -1;
+    if (fen[i] == '-') i++;
+    else {
+        if (i + 2 > n || fen[i] < 'a' || fen[i] > 'h') return "bad en passant square";
+        int c = fen[i] - 'a';
+        int r = '8' - fen[i + 1];
+        i += 2;
+        // The pawn that just moved two squares stands in front of the target, the
+        // target and the square it came from are empty
+        int dir = pos.whiteToMove ? 1 : -1;
+        Piece pushed = pos.whiteToMove ? B_PAWN : W_PAWN;
+        if (r != (pos.whiteToMove ? 2 : 5)) return "en passant square on the wrong rank";
+        if (b[r + dir][c] != pushed || b[r][c] != EMPTY || b[r - dir][c] != EMPTY)
+            return "en passant square without a pawn that just moved two squares";
+        pos.epRow = (int8_t)r;
+        pos.epCol = (int8_t)c;
+    }
+
+    // ---------- Move counters (optional) ----------
+    pos.halfmoveClock = 0;
+    pos.fullmoveNumber = 1;
+    if (i == n) return nullptr;
+    if (fen[i] != ' ') return "unexpected text after en passant square";
+    i++;
+    if (!readCounter(fen, i, pos.halfmoveClock)) return "bad halfmove clock";
+    if (i >= n || fen[i] != ' ') return "missing fullmove number";
+    i++;
+    if (!readCounter(fen, i, pos.fullmoveNumber)) return "bad fullmove number";
+    if (i != n) return "unexpected text after fullmove number";
+    if (pos.fullmoveNumber == 0) pos.fullmoveNumber = 1;   // some generators start at 0
+
+    return nullptr;
+}
+
+int writeFen(const FenPosition& pos, char* out) {
+    char* p = out;
+
+    for (int r = 0; r < 8; r++) {
+        int empty = 0;
+        for (int c = 0; c < 8; c++) {
+            Piece piece = pos.board[r][c];
+            if (piece == EMPTY) { empty++; continue; }
+            if (empty) { *p++ = char('0' + empty); empty = 0; }
+            *p++ = pieceToChar(piece);
+        }
+        if (empty) *p++ = char('0' + empty);
+        if (r < 7) *p++ = '/';
+    }
+
+    *p++ = ' ';
+    *p++ = pos.whiteToMove ? 'w' : 'b';
+
+    *p++ = ' ';
+    if (pos.castling == 0) *p++ = '-';
+    if (pos.castling & CASTLE_WHITE_KING) *p++ = 'K';
+    if (pos.castling & CASTLE_WHITE_QUEEN) *p++ = 'Q';
+    if (pos.castling & CASTLE_BLACK_KING) *p++ = 'k';
+    if (pos.castling & CASTLE_BLACK_QUEEN) *p++ = 'q';
+
+    *p++ = ' ';
+    if (pos.epCol < 0) *p++ = '-';
+    else {
+        *p++ = char('a' + pos.epCol);
+        *p++ = char('8' - pos.epRow);
+    }
+
+    *p++ = ' ';
+    p = writeCounter(p, pos.halfmoveClock);
+    *p++ = ' ';
+    p = writeCounter(p, pos.fullmoveNumber);
+    *p = '\0';
+
+    return (int)(p - out);
+}
+
+std::string toFen(const FenPosition& pos) {
+    char buf[FEN_MAX_LENGTH];
+    int len = writeFen(pos, buf);
+    return std::string(buf, len);
+}
+
+bool applyUciMove(FenPosition& pos, std::string_view uci) {
+    if (uci.size() != 4 && uci.size() != 5) return false;
+    if (uci[0] < 'a' || uci[0] > 'h' || uci[2] < 'a' || uci[2] > 'h') return false;
+    if (uci[1] < '1' || uci[1] > '8' || uci[3] < '1' || uci[3] > '8') return false;
+    int sr = '8' - uci[1], sc = uci[0] - 'a';
+    int dr = '8' - uci[3], dc = uci[2] - 'a';
+
+    Piece piece = pos.board[sr][sc];
+    Piece target = pos.board[dr][dc];
+    bool white = pos.whiteToMove;
+    if (piece == EMPTY || isWhitePiece(piece) != white) return false;
+    if (target != EMPTY && isWhitePiece(target) == white) return false;
+
+    int type = pieceType(piece);
+    Piece placed = piece;
+    if (uci.size() == 5) {
+        Piece promo = pieceFromChar(uci[4]);
+        if (type != PAWN || dr != (white ? 0 : 7) || promo == EMPTY || !isBlackPiece(promo) || pieceType(promo) == PAWN || pieceType(promo) == KING)
+            return false;
+        placed = makePiece(pieceType(promo), white);
+    }
+    else if (type == PAWN && (dr == 0 || dr == 7)) return false;
+
+    bool capture = target != EMPTY;
+    if (type == PAWN && sc != dc && target == EMPTY) {
+        if (dr != pos.epRow || dc != pos.epCol) return false;
+        pos.board[sr][dc] = EMPTY;      // en passant victim beside the origin
+        capture = true;
+    }
+    if (type == KING && (dc - sc == 2 || sc - dc == 2)) {
+        int rookFrom = dc > sc ? 7 : 0, rookTo = dc > sc ? 5 : 3;
+        pos.board[sr][rookTo] = pos.board[sr][rookFrom];
+        pos.board[sr][rookFrom] = EMPTY;
+    }
+    pos.board[dr][dc] = placed;
+    pos.board[sr][sc] = EMPTY;
+
+    // Rights go when the king or a rook leaves home, or a rook is taken there
+    if (piece == W_KING) pos.castling &= ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN);
+    if (piece == B_KING) pos.castling &= ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+    const int corner[4][2] = { { 7, 7 }, { 7, 0 }, { 0, 7 }, { 0, 0 } };     // in CASTLE_* bit order
+    for (int i = 0; i < 4; i++)
+        if ((sr == corner[i][0] && sc == corner[i][1]) || (dr == corner[i][0] && dc == corner[i][1]))
+            pos.castling &= ~(1 << i);
+
+    pos.epRow = pos.epCol = -1;
+    if (type == PAWN && (dr - sr == 2 || sr - dr == 2)) {
+        pos.epRow = (int8_t)((sr + dr) / 2);
+        pos.epCol = (int8_t)sc;
+    }
+
+    pos.halfmoveClock = (type == PAWN || capture) ? 0 : pos.halfmoveClock + 1;
+    if (!white) pos.fullmoveNumber++;
+    pos.whiteToMove = !white;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef FENPARSER_H
+#define FENPARSER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "ChessPiece.h"
+
+// Everything a FEN string describes, in the board layout the game uses (row 0 = rank 8)
+struct FenPosition {
+    Piece board[8][8];
+    bool whiteToMove;
+    uint8_t castling;           // CASTLE_* bits still available
+    int8_t epRow, epCol;        // en passant target square, -1 when there is none
+    int halfmoveClock;
+    int fullmoveNumber;
+};
+
+enum CastlingRight : uint8_t {
+    CASTLE_WHITE_KING = 1,
+    CASTLE_WHITE_QUEEN = 2,
+    CASTLE_BLACK_KING = 4,
+    CASTLE_BLACK_QUEEN = 8
+};
+
+// Longest FEN writeFen can produce, terminator included
+const int FEN_MAX_LENGTH = 96;
+
+// Reads a FEN without allocating. Returns nullptr on success, otherwise a short reason
+// and 'pos' is left partly written. The two move counters may be left out (EPD style).
+const char* parseFen(std::string_view fen, FenPosition& pos);
+
+// Writes a NUL-terminated FEN into 'out' (FEN_MAX_LENGTH bytes) and returns its length
+int writeFen(const FenPosition& pos, char* out);
+std::string toFen(const FenPosition& pos);
+
+// Plays a move written in UCI ("e2e4", "e7e8q") on 'pos'. Only checks that a piece of the
+// side to move stands on the origin and the target is not its own; castling, en passant
+// and promotion follow from the pieces involved. Returns false and leaves 'pos' alone otherwise.
+bool applyUciMove(FenPosition& pos, std::string_view uci);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file through the OS page cache (mmap / MapViewOfFile).
+// Pages are loaded on first touch, so multi-gigabyte files cost no up-front reading.
+class MappedFile {
+private:
+    const char* ptr;        // nullptr for an empty file, which cannot be mapped
+    size_t len;
+    bool opened;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    // Hint that the file will be read front to back
+    void adviseSequential() const;
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+#endif
@@ -0,0 +1,277 @@
+#include "NnueEvaluator.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_USE_AVX2
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define NNUE_USE_SSE4
+#endif
+
+// File layout (little-endian): "CNUE", version, feature count, half dims, hidden dims,
+// then each layer's biases followed by its weights, input-major for the first layer
+// and output-major for the dense layers.
+static const char NNUE_MAGIC[4] = { 'C', 'N', 'U', 'E' };
+static const uint32_t NNUE_VERSION = 1;
+
+// Output of the dense layers is scaled down by 2^6 before clipping, final output by 16
+static const int NNUE_WEIGHT_SHIFT = 6;
+static const int NNUE_OUTPUT_SCALE = 16;
+
+NnueEvaluator::NnueEvaluator() : outBias(0), ply(0), overflow(0), loaded(false) {
+}
+
+template <typename T>
+static bool readArray(std::ifstream& in, std::vector<T>& dst, size_t count) {
+    dst.resize(count);
+    in.read(reinterpret_cast<char*>(dst.data()), count * sizeof(T));
+    return (bool)in;
+}
+
+bool NnueEvaluator::load(const std::string& path) {
+    loaded = false;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[4];
+    uint32_t header[4];
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || memcmp(magic, NNUE_MAGIC, 4) != 0 || header[0] != NNUE_VERSION ||
+        header[1] != NNUE_FEATURES || header[2] != NNUE_HALF_DIMS || header[3] != NNUE_HIDDEN)
+        return false;
+
+    if (!readArray(in, ftBiases, NNUE_HALF_DIMS)) return false;
+    if (!readArray(in, ftWeights, (size_t)NNUE_FEATURES * NNUE_HALF_DIMS)) return false;
+    if (!readArray(in, l1Biases, NNUE_HIDDEN)) return false;
+    if (!readArray(in, l1Weights, (size_t)NNUE_HIDDEN * 2 * NNUE_HALF_DIMS)) return false;
+    if (!readArray(in, l2Biases, NNUE_HIDDEN)) return false;
+    if (!readArray(in, l2Weights, (size_t)NNUE_HIDDEN * NNUE_HIDDEN)) return false;
+    in.read(reinterpret_cast<char*>(&outBias), sizeof(outBias));
+    if (!readArray(in, outWeights, NNUE_HIDDEN)) return false;
+
+    ply = 0;
+    overflow = 0;
+    loaded = true;
+    return true;
+}
+
+// ===================== FEATURES =====================
+
+// Pawn..queen of the perspective's own colour are slots 0-4, the opponent's 5-9; kings have no slot
+static const int TYPE_SLOT[8] = { -1, 0, 3, 1, 2, 4, -1, -1 };   // by PieceType: P N B R Q order
+
+static int featureSlot(Piece p, int side) {
+    int type = TYPE_SLOT[pieceType(p)];
+    if (type < 0) return -1;
+    bool own = isWhitePiece(p) == (side == 0);
+    return own ? type : type + 5;
+}
+
+// Black looks at the board upside down, so both perspectives share one weight set
+static int orient(int sq, int side) {
+    return side == 0 ? sq : sq ^ 56;
+}
+
+static int featureIndex(int kingSq, Piece p, int sq, int side) {
+    int slot = featureSlot(p, side);
+    if (slot < 0) return -1;
+    return orient(kingSq, side) * 640 + slot * 64 + orient(sq, side);
+}
+
+static int findKingSquare(const Piece board[8][8], int side) {
+    Piece king = side == 0 ? W_KING : B_KING;
+    for (int sq = 0; sq < 64; sq++)
+        if (board[sq / 8][sq % 8] == king) return sq;
+    return -1;
+}
+
+// ===================== ACCUMULATOR KERNELS =====================
+
+void NnueEvaluator::addFeature(int16_t* acc, int feature) const {
+    const int16_t* w = &ftWeights[(size_t)feature * NNUE_HALF_DIMS];
+#if defined(NNUE_USE_AVX2)
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, b));
+    }
+#elif defined(NNUE_USE_SSE4)
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 8) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, b));
+    }
+#else
+    for (int i = 0; i < NNUE_HALF_DIMS; i++) acc[i] += w[i];
+#endif
+}
+
+void NnueEvaluator::subFeature(int16_t* acc, int feature) const {
+    const int16_t* w = &ftWeights[(size_t)feature * NNUE_HALF_DIMS];
+#if defined(NNUE_USE_AVX2)
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_sub_epi16(a, b));
+    }
+#elif defined(NNUE_USE_SSE4)
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 8) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(acc + i), _mm_sub_epi16(a, b));
+    }
+#else
+    for (int i = 0; i < NNUE_HALF_DIMS; i++) acc[i] -= w[i];
+#endif
+}
+
+void NnueEvaluator::refreshPerspective(const Piece board[8][8], int side, NnueAccumulator& acc) const {
+    int16_t* values = acc.values[side];
+    memcpy(values, ftBiases.data(), sizeof(int16_t) * NNUE_HALF_DIMS);
+
+    int kingSq = findKingSquare(board, side);
+    if (kingSq < 0) return;
+
+    for (int sq = 0; sq < 64; sq++) {
+        Piece p = board[sq / 8][sq % 8];
+        if (p == EMPTY) continue;
+        int f = featureIndex(kingSq, p, sq, side);
+        if (f >= 0) addFeature(values, f);
+    }
+}
+
+void NnueEvaluator::refresh(const Piece board[8][8]) {
+    ply = 0;
+    overflow = 0;
+    refreshPerspective(board, 0, stack[0]);
+    refreshPerspective(board, 1, stack[0]);
+}
+
+void NnueEvaluator::push(const Piece before[8][8], const Piece after[8][8]) {
+    // Past the end of the stack the deepest frame keeps being evaluated;
+    // count the pushes so the matching pops leave ply where it was.
+    if (ply + 1 >= NNUE_MAX_PLY) {
+        overflow++;
+        return;
+    }
+    NnueAccumulator& acc = stack[ply + 1];
+    acc = stack[ply];
+    ply++;
+
+    for (int side = 0; side < 2; side++) {
+        int kingSq = findKingSquare(after, side);
+        // HalfKP features are relative to the own king, so a king move invalidates the whole half
+        if (kingSq != findKingSquare(before, side)) {
+            refreshPerspective(after, side, acc);
+            continue;
+        }
+
+        for (int sq = 0; sq < 64; sq++) {
+            Piece was = before[sq / 8][sq % 8];
+            Piece now = after[sq / 8][sq % 8];
+            if (was == now) continue;
+
+            if (was != EMPTY) {
+                int f = featureIndex(kingSq, was, sq, side);
+                if (f >= 0) subFeature(acc.values[side], f);
+            }
+            if (now != EMPTY) {
+                int f = featureIndex(kingSq, now, sq, side);
+                if (f >= 0) addFeature(acc.values[side], f);
+            }
+        }
+    }
+}
+
+void NnueEvaluator::pop() {
+    if (overflow > 0) overflow--;
+    else if (ply > 0) ply--;
+}
+
+// ===================== DENSE LAYERS =====================
+
+// Dot product of clipped uint8 activations with int8 weights; n is a multiple of 32
+static int32_t dotProduct(const uint8_t* input, const int8_t* weights, int n) {
+#if defined(NNUE_USE_AVX2)
+    __m256i sum = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int i = 0; i < n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(NNUE_USE_SSE4)
+    __m128i sum = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int i = 0; i < n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(a, b), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++) sum += (int32_t)input[i] * weights[i];
+    return sum;
+#endif
+}
+
+// int16 accumulator -> uint8 in [0, 127]; n is a multiple of 32
+static void clippedRelu(const int16_t* input, uint8_t* output, int n) {
+#if defined(NNUE_USE_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(input + i));
+        __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(input + i + 16));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+        // packs works per 128-bit lane; restore the original element order
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+    }
+#elif defined(NNUE_USE_SSE4)
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(input + i));
+        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+#else
+    for (int i = 0; i < n; i++) output[i] = (uint8_t)std::max(0, std::min(127, (int)input[i]));
+#endif
+}
+
+static void denseLayer(const uint8_t* input, int inDims, const int8_t* weights, const int32_t* biases,
+    uint8_t* output, int outDims) {
+    for (int o = 0; o < outDims; o++) {
+        int32_t sum = biases[o] + dotProduct(input, weights + (size_t)o * inDims, inDims);
+        output[o] = (uint8_t)std::max(0, std::min(127, sum >> NNUE_WEIGHT_SHIFT));
+    }
+}
+
+int NnueEvaluator::evaluate() const {
+    const NnueAccumulator& acc = stack[ply];
+
+    alignas(32) uint8_t transformed[2 * NNUE_HALF_DIMS];
+    alignas(32) uint8_t hidden1[NNUE_HIDDEN];
+    alignas(32) uint8_t hidden2[NNUE_HIDDEN];
+
+    clippedRelu(acc.values[0], transformed, NNUE_HALF_DIMS);
+    clippedRelu(acc.values[1], transformed + NNUE_HALF_DIMS, NNUE_HALF_DIMS);
+
+    denseLayer(transformed, 2 * NNUE_HALF_DIMS, l1Weights.data(), l1Biases.data(), hidden1, NNUE_HIDDEN);
+    denseLayer(hidden1, NNUE_HIDDEN, l2Weights.data(), l2Biases.data(), hidden2, NNUE_HIDDEN);
+
+    int32_t out = outBias + dotProduct(hidden2, outWeights.data(), NNUE_HIDDEN);
+    return out / NNUE_OUTPUT_SCALE;
+}
@@ -0,0 +1,58 @@
+#ifndef NNUEEVALUATOR_H
+#define NNUEEVALUATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ChessPiece.h"
+
+// Small HalfKP network: (king square, piece, square) features per perspective
+// -> 2 x 128 accumulator -> 32 -> 32 -> 1. Weights load from a local file and
+// the first layer is updated incrementally as the search makes and unmakes moves.
+
+const int NNUE_FEATURES = 64 * 10 * 64;    // own king square x non-king piece x square
+const int NNUE_HALF_DIMS = 128;
+const int NNUE_HIDDEN = 32;
+const int NNUE_MAX_PLY = 128;
+
+struct NnueAccumulator {
+    alignas(32) int16_t values[2][NNUE_HALF_DIMS];   // [0] White's perspective, [1] Black's
+};
+
+class NnueEvaluator {
+private:
+    std::vector<int16_t> ftBiases;      // NNUE_HALF_DIMS
+    std::vector<int16_t> ftWeights;     // NNUE_FEATURES x NNUE_HALF_DIMS
+    std::vector<int32_t> l1Biases;      // NNUE_HIDDEN
+    std::vector<int8_t> l1Weights;      // NNUE_HIDDEN x 2*NNUE_HALF_DIMS
+    std::vector<int32_t> l2Biases;      // NNUE_HIDDEN
+    std::vector<int8_t> l2Weights;      // NNUE_HIDDEN x NNUE_HIDDEN
+    int32_t outBias;
+    std::vector<int8_t> outWeights;     // NNUE_HIDDEN
+
+    NnueAccumulator stack[NNUE_MAX_PLY];
+    int ply;
+    int overflow;                       // pushes past the end of stack
+    bool loaded;
+
+    void refreshPerspective(const Piece board[8][8], int side, NnueAccumulator& acc) const;
+    void addFeature(int16_t* acc, int feature) const;
+    void subFeature(int16_t* acc, int feature) const;
+
+public:
+    NnueEvaluator();
+
+    bool load(const std::string& path);
+    bool isLoaded() const { return loaded; }
+
+    // Full recompute at the search root
+    void refresh(const Piece board[8][8]);
+    // Incremental update from the squares that differ between the two boards
+    void push(const Piece before[8][8], const Piece after[8][8]);
+    void pop();
+
+    // Static score in centipawns from White's point of view
+    int evaluate() const;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "PgnReader.h"
+#include <cstring>
+#include <thread>
+
+std::string_view PgnGame::tag(std::string_view name) const {
+    for (const PgnTag& t : tags)
+        if (t.name == name) return t.value;
+    return std::string_view();
+}
+
+void PgnGame::clear() {
+    tags.clear();
+    moves.clear();
+    result = std::string_view();
+    offset = 0;
+}
+
+bool PgnReader::open(const std::string& path) {
+    if (!file.open(path)) return false;
+    file.adviseSequential();
+    return true;
+}
+
+// ===================== TOKENISER =====================
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+}
+
+static inline bool atLineStart(const char* p, const char* begin) {
+    return p == begin || p[-1] == '\n';
+}
+
+static const char* skipLine(const char* p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+static const char* skipPast(const char* p, const char* end, char c) {
+    const char* hit = (const char*)memchr(p, c, end - p);
+    return hit ? hit + 1 : end;
+}
+
+// Skips a "( ... )" variation, nested ones and comments inside it included
+static const char* skipVariation(const char* p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '{') { p = skipPast(p + 1, end, '}'); continue; }
+        if (c == ';') { p = skipLine(p, end); continue; }
+        p++;
+        if (c == '(') depth++;
+        else if (c == ')' && --depth == 0) break;
+    }
+    return p;
+}
+
+static bool isResult(std::string_view token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// Reads one game starting at p, which is at its first tag or first move. Returns the
+// position just after the game: past its result, or at the next game's tag section.
+static const char* parseGame(const char* p, const char* begin, const char* end, PgnGame& game) {
+    // ---------- Tag pairs ----------
+    while (p < end) {
+        while (p < end && isSpace(*p)) p++;
+        if (p == end || *p != '[') break;
+
+        const char* name = ++p;
+        while (p < end && !isSpace(*p) && *p != '"' && *p != ']') p++;
+        std::string_view tagName(name, p - name);
+
+        while (p < end && isSpace(*p)) p++;
+        std::string_view value;
+        if (p < end && *p == '"') {
+            const char* v = ++p;
+            while (p < end && *p != '"') p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            value = std::string_view(v, (p < end ? p : end) - v);
+        }
+        game.tags.push_back({ tagName, value });
+        p = skipLine(p, end);
+    }
+
+    // ---------- Movetext ----------
+    while (p < end) {
+        char c = *p;
+        if (isSpace(c)) { p++; continue; }
+
+        if (c == '[' && atLineStart(p, begin)) break;     // next game, this one had no result
+        if (c == '%' && atLineStart(p, begin)) { p = skipLine(p, end); continue; }
+        if (c == '{') { p = skipPast(p + 1, end, '}'); continue; }
+        if (c == ';') { p = skipLine(p, end); continue; }
+        if (c == '(') { p = skipVariation(p, end); continue; }
+        if (c == '$') { p++; while (p < end && *p >= '0' && *p <= '9') p++; continue; }
+
+        const char* t = p;
+        while (p < end && !isSpace(*p) && !strchr("{}();[", *p)) p++;
+        std::string_view token(t, p - t);
+        if (token.empty()) { p++; continue; }      // stray ')' or '}'
+
+        if (isResult(token)) {
+            game.result = token;
+            break;
+        }
+
+        // Move numbers: "12." "12..." and "12.e4" with the move attached
+        if (token[0] >= '1' && token[0] <= '9') {
+            size_t i = 0;
+            while (i < token.size() && token[i] >= '0' && token[i] <= '9') i++;
+            if (i < token.size() && token[i] != '.') {
+                game.moves.push_back(token);    // not a number after all, leave it to the SAN decoder
+                continue;
+            }
+            while (i < token.size() && token[i] == '.') i++;
+            token.remove_prefix(i);
+            if (token.empty()) continue;
+        }
+        game.moves.push_back(token);
+    }
+    return p;
+}
+
+// ===================== CHUNKS & WORKERS =====================
+
+// Start of the first game whose "[Event " line begins at or after 'from'
+size_t PgnReader::nextGameStart(size_t from) const {
+    if (from == 0) return 0;
+    std::string_view text(file.data(), file.size());
+    size_t hit = text.find("\n[Event ", from - 1);
+    return hit == std::string_view::npos ? file.size() : hit + 1;
+}
+
+size_t PgnReader::readRange(size_t beginOffset, size_t endOffset, int worker, const PgnGameCallback& onGame, std::atomic<bool>& stop) const {
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const char* p = begin + beginOffset;
+    const char* limit = begin + endOffset;
+
+    PgnGame game;
+    size_t count = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        while (p < end && isSpace(*p)) p++;
+        if (p >= limit) break;      // a game starting past the chunk is the next worker's
+
+        game.clear();
+        game.offset = (size_t)(p - begin);
+        const char* next = parseGame(p, begin, end, game);
+        if (next == p) next = skipLine(p, end);     // nothing readable here
+        p = next;
+
+        if (game.tags.empty() && game.moves.empty()) continue;
+        count++;
+        if (!onGame(game, worker)) stop = true;
+    }
+    return count;
+}
+
+size_t PgnReader::forEachGame(const PgnGameCallback& onGame, int threads) const {
+    if (!file.isOpen() || file.size() == 0) return 0;
+    std::atomic<bool> stop(false);
+
+    // Small files are not worth the threads
+    if (threads <= 1 || file.size() < ((size_t)1 << 20))
+        return readRange(0, file.size(), 0, onGame, stop);
+
+    std::vector<size_t> starts(threads + 1);
+    for (int i = 0; i < threads; i++) starts[i] = nextGameStart(file.size() / threads * i);
+    starts[threads] = file.size();
+
+    std::vector<size_t> counts(threads, 0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&, i]() {
+            if (starts[i] < starts[i + 1])
+                counts[i] = readRange(starts[i], starts[i + 1], i, onGame, stop);
+        });
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i].join();
+        total += counts[i];
+    }
+    return total;
+}
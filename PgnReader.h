@@ -0,0 +1,48 @@
+#ifndef PGNREADER_H
+#define PGNREADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+struct PgnTag {
+    std::string_view name;
+    std::string_view value;     // as written, escapes not undone
+};
+
+// One game, pointing straight into the mapped file. The vectors are reused from game to
+// game, so a worker allocates only while they grow to the longest game it has seen.
+struct PgnGame {
+    std::vector<PgnTag> tags;
+    std::vector<std::string_view> moves;    // SAN of the main line; comments, NAGs and variations dropped
+    std::string_view result;                // "1-0", "0-1", "1/2-1/2", "*", or empty if missing
+    size_t offset;                          // byte position of the game in the file
+
+    std::string_view tag(std::string_view name) const;
+    void clear();
+};
+
+// Return false to stop reading. With several workers it is called from all of them at once.
+typedef std::function<bool(const PgnGame& game, int worker)> PgnGameCallback;
+
+class PgnReader {
+private:
+    MappedFile file;
+
+    size_t readRange(size_t begin, size_t end, int worker, const PgnGameCallback& onGame, std::atomic<bool>& stop) const;
+    size_t nextGameStart(size_t from) const;
+
+public:
+    bool open(const std::string& path);
+    size_t fileSize() const { return file.size(); }
+
+    // Calls onGame for every game and returns how many were read. With threads > 1 the
+    // file is cut at "[Event " lines into one chunk per worker and games arrive out of order.
+    size_t forEachGame(const PgnGameCallback& onGame, int threads = 1) const;
+};
+
+#endif
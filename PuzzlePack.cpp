@@ -0,0 +1,178 @@
+#include "PuzzlePack.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// ===================== POSITIONS & MOVES =====================
+
+bool packPosition(const FenPosition& pos, PuzzleRecord& rec) {
+    rec.occupied = 0;
+    memset(rec.pieces, 0, sizeof(rec.pieces));
+    int n = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        Piece p = pos.board[sq / 8][sq % 8];
+        if (p == EMPTY) continue;
+        if (n == 32) return false;
+        rec.occupied |= 1ULL << sq;
+        rec.pieces[n / 2] |= (uint8_t)(p << (n % 2 * 4));
+        n++;
+    }
+
+    rec.flags = (uint8_t)((pos.whiteToMove ? PACK_WHITE_TO_MOVE : 0) | (pos.castling & 15) << 1);
+    rec.epSquare = pos.epRow >= 0 ? (int8_t)(pos.epRow * 8 + pos.epCol) : -1;
+    rec.halfmoveClock = (uint8_t)std::min(pos.halfmoveClock, 255);
+    rec.fullmoveNumber = (uint16_t)std::min(std::max(pos.fullmoveNumber, 1), 65535);
+    return true;
+}
+
+void unpackPosition(const PuzzleRecord& rec, FenPosition& pos) {
+    memset(pos.board, EMPTY, sizeof(pos.board));
+    int n = 0;
+    for (uint64_t b = rec.occupied; b; b &= b - 1, n++) {
+        int sq = 0;
+        while (!(b >> sq & 1)) sq++;
+        pos.board[sq / 8][sq % 8] = (Piece)(rec.pieces[n / 2] >> (n % 2 * 4) & 15);
+    }
+
+    pos.whiteToMove = (rec.flags & PACK_WHITE_TO_MOVE) != 0;
+    pos.castling = (uint8_t)(rec.flags >> 1 & 15);
+    pos.epRow = rec.epSquare >= 0 ? (int8_t)(rec.epSquare / 8) : -1;
+    pos.epCol = rec.epSquare >= 0 ? (int8_t)(rec.epSquare % 8) : -1;
+    pos.halfmoveClock = rec.halfmoveClock;
+    pos.fullmoveNumber = rec.fullmoveNumber;
+}
+
+uint16_t encodeUciMove(std::string_view uci) {
+    if (uci.size() < 4 || uci.size() > 5) return 0;
+    for (int i = 0; i < 4; i += 2)
+        if (uci[i] < 'a' || uci[i] > 'h' || uci[i + 1] < '1' || uci[i + 1] > '8') return 0;
+
+    int from = ('8' - uci[1]) * 8 + (uci[0] - 'a');
+    int to = ('8' - uci[3]) * 8 + (uci[2] - 'a');
+    int promotion = 0;
+    if (uci.size() == 5) {
+        if (!strchr("qrbn", uci[4])) return 0;
+        promotion = pieceType(pieceFromChar(uci[4]));
+    }
+    if (from == to) return 0;
+    return packMove(from, to, promotion);
+}
+
+std::string uciMoveText(uint16_t move) {
+    int from = packedFrom(move), to = packedTo(move), promotion = packedPromotion(move);
+    std::string s;
+    s += char('a' + from % 8);
+    s += char('8' - from / 8);
+    s += char('a' + to % 8);
+    s += char('8' - to / 8);
+    if (promotion) s += pieceToChar(makePiece(promotion, false));
+    return s;
+}
+
+// ===================== READER =====================
+
+PuzzlePack::PuzzlePack() : header(nullptr), records(nullptr), themeNames(nullptr), strings(nullptr) {
+}
+
+bool PuzzlePack::open(const std::string& path) {
+    close();
+    if (!file.open(path) || file.size() < sizeof(PuzzlePackHeader)) {
+        file.close();
+        return false;
+    }
+
+    const char* base = file.data();
+    const uint64_t size = file.size();
+    const PuzzlePackHeader* h = (const PuzzlePackHeader*)base;
+
+    bool valid = memcmp(h->magic, PUZZLE_PACK_MAGIC, sizeof(h->magic)) == 0
+        && h->version == PUZZLE_PACK_VERSION
+        && h->recordSize == sizeof(PuzzleRecord)
+        && h->themeCount <= PACK_MAX_THEMES
+        && h->recordsOffset % 8 == 0 && h->themeTableOffset % 4 == 0
+        && h->recordsOffset <= size && h->recordCount <= (size - h->recordsOffset) / sizeof(PuzzleRecord)
+        && h->themeTableOffset <= size && h->themeCount * 4ULL <= size - h->themeTableOffset
+        && h->stringsOffset <= size && h->stringsSize >= 1 && h->stringsSize <= size - h->stringsOffset
+        && base[h->stringsOffset + h->stringsSize - 1] == '\0';
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    header = h;
+    records = (const PuzzleRecord*)(base + h->recordsOffset);
+    themeNames = (const uint32_t*)(base + h->themeTableOffset);
+    strings = base + h->stringsOffset;
+    return true;
+}
+
+void PuzzlePack::close() {
+    file.close();
+    header = nullptr;
+    records = nullptr;
+    themeNames = nullptr;
+    strings = nullptr;
+}
+
+const char* PuzzlePack::text(uint32_t offset) const {
+    return header && offset < header->stringsSize ? strings + offset : "";
+}
+
+size_t PuzzlePack::lowerBound(int rating) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (records[mid].rating < rating) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// ===================== WRITER =====================
+
+PuzzlePackWriter::PuzzlePackWriter() : strings(1, '\0') {
+}
+
+int PuzzlePackWriter::themeBit(std::string_view name) {
+    for (size_t i = 0; i < themes.size(); i++)
+        if (themes[i] == name) return (int)i;
+    if ((int)themes.size() == PACK_MAX_THEMES) return -1;
+    themes.emplace_back(name);
+    return (int)themes.size() - 1;
+}
+
+uint32_t PuzzlePackWriter::addText(std::string_view s) {
+    if (s.empty()) return 0;
+    uint32_t offset = (uint32_t)strings.size();
+    strings.append(s.data(), s.size());
+    strings += '\0';
+    return offset;
+}
+
+bool PuzzlePackWriter::write(const std::string& path) {
+    std::stable_sort(records.begin(), records.end(),
+        [](const PuzzleRecord& a, const PuzzleRecord& b) { return a.rating < b.rating; });
+
+    std::vector<uint32_t> themeTable;
+    for (const std::string& t : themes) themeTable.push_back(addText(t));
+
+    PuzzlePackHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PUZZLE_PACK_MAGIC, sizeof(h.magic));
+    h.version = PUZZLE_PACK_VERSION;
+    h.recordSize = sizeof(PuzzleRecord);
+    h.recordCount = records.size();
+    h.recordsOffset = sizeof(PuzzlePackHeader);
+    h.themeTableOffset = h.recordsOffset + records.size() * sizeof(PuzzleRecord);
+    h.themeCount = (uint32_t)themeTable.size();
+    h.stringsOffset = h.themeTableOffset + themeTable.size() * sizeof(uint32_t);
+    h.stringsSize = strings.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)records.data(), records.size() * sizeof(PuzzleRecord));
+    out.write((const char*)themeTable.data(), themeTable.size() * sizeof(uint32_t));
+    out.write(strings.data(), strings.size());
+    return (bool)out;
+}
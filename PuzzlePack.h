@@ -0,0 +1,124 @@
+#ifndef PUZZLEPACK_H
+#define PUZZLEPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FenParser.h"
+#include "MappedFile.h"
+
+// Binary puzzle pack (.pack), read in place through a memory map. Little-endian:
+//
+//   PuzzlePackHeader                       64 bytes
+//   PuzzleRecord[recordCount]              88 bytes each, sorted by rating
+//   uint32_t themeNames[themeCount]        string table offsets, bit i of themeMask
+//   string table                           NUL-terminated, offset 0 is ""
+//
+// Opening one reads only the header, and every process using the file shares its pages.
+
+const char PUZZLE_PACK_MAGIC[8] = { 'C', 'H', 'S', 'P', 'U', 'Z', 'Z', '1' };
+const uint32_t PUZZLE_PACK_VERSION = 2;
+const int PACK_MAX_MOVES = 16;
+const int PACK_MAX_THEMES = 128;     // Lichess uses about 70 tags
+
+struct PuzzlePackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t recordsOffset;
+    uint64_t themeTableOffset;
+    uint32_t themeCount;
+    uint32_t reserved;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+// One puzzle. The position is an occupancy bitboard (bit r*8+c, row 0 = rank 8) plus one
+// 4-bit piece code per occupied square in ascending square order, two to a byte.
+struct PuzzleRecord {
+    uint64_t occupied;
+    uint8_t pieces[16];
+    uint64_t themeMask[PACK_MAX_THEMES / 64];
+    uint16_t moves[PACK_MAX_MOVES];     // see encodeUciMove
+    uint32_t id;
+    uint32_t description;               // string table offset
+    uint16_t rating;
+    uint16_t fullmoveNumber;
+    uint8_t moveCount;
+    uint8_t flags;                      // PACK_WHITE_TO_MOVE | castling rights << 1
+    int8_t epSquare;                    // -1 when there is none
+    uint8_t halfmoveClock;
+};
+
+const uint8_t PACK_WHITE_TO_MOVE = 1;
+
+static_assert(sizeof(PuzzlePackHeader) == 64, "pack header layout");
+static_assert(sizeof(PuzzleRecord) == 88, "pack record layout");
+
+inline bool hasPackTheme(const PuzzleRecord& rec, int bit) { return rec.themeMask[bit >> 6] >> (bit & 63) & 1; }
+
+// Position <-> record. packPosition fails on more than 32 pieces.
+bool packPosition(const FenPosition& pos, PuzzleRecord& rec);
+void unpackPosition(const PuzzleRecord& rec, FenPosition& pos);
+
+// A move is from | to << 6 | promoted piece type << 12, squares as r*8+c; 0 is never a
+// move (a8a8). Puzzle solutions and the moves played against them use this form.
+inline uint16_t packMove(int from, int to, int promotionType = 0) { return (uint16_t)(from | to << 6 | promotionType << 12); }
+inline int packedFrom(uint16_t move) { return move & 63; }
+inline int packedTo(uint16_t move) { return move >> 6 & 63; }
+inline int packedPromotion(uint16_t move) { return move >> 12 & 7; }
+
+// Purely syntactic; 0 when malformed
+uint16_t encodeUciMove(std::string_view uci);
+std::string uciMoveText(uint16_t move);
+
+class PuzzlePack {
+private:
+    MappedFile file;
+    const PuzzlePackHeader* header;
+    const PuzzleRecord* records;
+    const uint32_t* themeNames;
+    const char* strings;
+
+public:
+    PuzzlePack();
+
+    // Checks the header and section bounds only; records are not touched
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+    size_t size() const { return header ? (size_t)header->recordCount : 0; }
+    const PuzzleRecord& record(size_t index) const { return records[index]; }
+
+    int themeCount() const { return header ? (int)header->themeCount : 0; }
+    const char* themeName(int bit) const { return text(themeNames[bit]); }
+    const char* text(uint32_t offset) const;
+
+    // First record rated at least 'rating'
+    size_t lowerBound(int rating) const;
+};
+
+// Collects records in memory and writes them out sorted by rating
+class PuzzlePackWriter {
+private:
+    std::vector<PuzzleRecord> records;
+    std::vector<std::string> themes;
+    std::string strings;
+
+public:
+    PuzzlePackWriter();
+
+    // Bit for a theme name, added on first use; -1 once PACK_MAX_THEMES are taken
+    int themeBit(std::string_view name);
+    uint32_t addText(std::string_view s);
+    void add(const PuzzleRecord& rec) { records.push_back(rec); }
+    size_t size() const { return records.size(); }
+
+    bool write(const std::string& path);
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "RoaringBitmap.h"
+#include <algorithm>
+#include <string>
+
+static const size_t BITMAP_WORDS = 65536 / 64;
+
+static inline int popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+// ===================== CONTAINERS =====================
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitmap()) return bits[low >> 6] >> (low & 63) & 1;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t& word = bits[low >> 6];
+        uint64_t bit = 1ULL << (low & 63);
+        if (word & bit) return false;
+        word |= bit;
+        cardinality++;
+        return true;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) return false;
+    array.insert(it, low);
+    cardinality++;
+
+    // Past this size the fixed 8 KB bitmap is the smaller form
+    if (cardinality > ROARING_ARRAY_MAX) {
+        bits.assign(BITMAP_WORDS, 0);
+        for (uint16_t v : array) bits[v >> 6] |= 1ULL << (v & 63);
+        std::vector<uint16_t>().swap(array);
+    }
+    return true;
+}
+
+size_t RoaringBitmap::Container::rank(uint16_t low) const {
+    if (!isBitmap()) return std::upper_bound(array.begin(), array.end(), low) - array.begin();
+
+    size_t n = 0;
+    size_t word = low >> 6;
+    for (size_t i = 0; i < word; i++) n += popcount64(bits[i]);
+    int shift = 63 - (low & 63);
+    return n + popcount64(bits[word] << shift);
+}
+
+// ===================== BITMAP =====================
+
+RoaringBitmap::RoaringBitmap() : total(0) {
+}
+
+size_t RoaringBitmap::lowerBound(uint16_t key) const {
+    size_t lo = 0, hi = containers.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool RoaringBitmap::add(uint32_t id) {
+    uint16_t key = (uint16_t)(id >> 16);
+    size_t i = lowerBound(key);
+    if (i == containers.size() || containers[i].key != key) {
+        Container c;
+        c.key = key;
+        c.cardinality = 0;
+        containers.insert(containers.begin() + i, std::move(c));
+        before.insert(before.begin() + i, i + 1 < containers.size() ? before[i] : total);
+    }
+    if (!containers[i].add((uint16_t)id)) return false;
+    for (size_t j = i + 1; j < before.size(); j++) before[j]++;
+    total++;
+    return true;
+}
+
+bool RoaringBitmap::contains(uint32_t id) const {
+    uint16_t key = (uint16_t)(id >> 16);
+    size_t i = lowerBound(key);
+    return i < containers.size() && containers[i].key == key && containers[i].contains((uint16_t)id);
+}
+
+void RoaringBitmap::clear() {
+    containers.clear();
+    before.clear();
+    total = 0;
+}
+
+size_t RoaringBitmap::rank(uint32_t id) const {
+    uint16_t key = (uint16_t)(id >> 16);
+    size_t i = lowerBound(key);
+    if (i == containers.size()) return total;
+    size_t n = before[i];
+    if (containers[i].key == key) n += containers[i].rank((uint16_t)id);
+    return n;
+}
+
+size_t RoaringBitmap::countRange(uint32_t first, uint32_t last) const {
+    if (first > last) return 0;
+    return rank(last) - (first == 0 ? 0 : rank(first - 1));
+}
+
+// ===================== TEXT FORM =====================
+
+void RoaringBitmap::write(std::ostream& out) const {
+    static const char hex[] = "0123456789abcdef";
+    out << containers.size() << '\n';
+    for (const Container& c : containers) {
+        out << c.key << (c.isBitmap() ? " b " : " a ") << c.cardinality;
+        if (c.isBitmap()) {
+            char word[18] = " ";
+            for (uint64_t w : c.bits) {
+                for (int d = 0; d < 16; d++) word[1 + d] = hex[w >> (60 - 4 * d) & 15];
+                out.write(word, 17);
+            }
+        }
+        else {
+            for (uint16_t v : c.array) out << ' ' << v;
+        }
+        out << '\n';
+    }
+}
+
+bool RoaringBitmap::read(std::istream& in) {
+    clear();
+    size_t count;
+    if (!(in >> count)) return false;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t key, cardinality;
+        std::string kind;
+        if (!(in >> key >> kind >> cardinality) || key > 0xFFFF) return false;
+        if (!containers.empty() && key <= containers.back().key) return false;
+
+        Container c;
+        c.key = (uint16_t)key;
+        c.cardinality = 0;
+        if (kind == "b") {
+            c.bits.resize(BITMAP_WORDS);
+            for (uint64_t& w : c.bits) {
+                if (!(in >> std::hex >> w >> std::dec)) return false;
+                c.cardinality += popcount64(w);
+            }
+        }
+        else if (kind == "a") {
+            c.array.resize(cardinality);
+            for (uint16_t& v : c.array) {
+                uint32_t low;
+                if (!(in >> low) || low > 0xFFFF) return false;
+                v = (uint16_t)low;
+            }
+            std::sort(c.array.begin(), c.array.end());
+            c.array.erase(std::unique(c.array.begin(), c.array.end()), c.array.end());
+            c.cardinality = (uint32_t)c.array.size();
+        }
+        else return false;
+
+        if (c.cardinality != cardinality) return false;
+        before.push_back(total);
+        total += c.cardinality;
+        containers.push_back(std::move(c));
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef ROARINGBITMAP_H
+#define ROARINGBITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Compressed set of 32-bit ids, after Roaring bitmaps. Ids are grouped by their high 16
+// bits; a group holds a sorted array of low halves while it is small and switches to a
+// 65536-bit bitmap past ROARING_ARRAY_MAX, which is where the bitmap gets smaller. Scattered
+// ids cost 2 bytes each, dense runs 1 bit each.
+const uint32_t ROARING_ARRAY_MAX = 4096;
+
+class RoaringBitmap {
+private:
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality;
+        std::vector<uint16_t> array;    // sorted low halves, while an array container
+        std::vector<uint64_t> bits;     // 1024 words, once a bitmap container
+
+        bool isBitmap() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        bool add(uint16_t low);
+        size_t rank(uint16_t low) const;     // members <= low
+    };
+
+    std::vector<Container> containers;  // sorted by key
+    std::vector<size_t> before;         // members in the containers ahead of each one
+    size_t total;
+
+    size_t lowerBound(uint16_t key) const;
+
+public:
+    RoaringBitmap();
+
+    // True when the id was not there yet
+    bool add(uint32_t id);
+    bool contains(uint32_t id) const;
+    void clear();
+
+    size_t cardinality() const { return total; }
+
+    // Members <= id, and members in [first, last]; a binary search over the containers
+    size_t rank(uint32_t id) const;
+    size_t countRange(uint32_t first, uint32_t last) const;
+
+    // Text form, one line per container: "<key> a <n> <low>..." or "<key> b <n> <hex word> x1024"
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+};
+
+#endif